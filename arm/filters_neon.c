@@ -0,0 +1,60 @@
+/*
+ * scale/eagle line kernels, NEON intrinsics
+ * (on 32bit ARM this needs -mfpu=neon, for this file only is fine)
+ *
+ * This work is licensed under the terms of any of these licenses
+ * (at your option):
+ *  - GNU GPL, version 2 or later.
+ *  - GNU LGPL, version 2.1 or later.
+ *  - MAME license.
+ * See the COPYING file in the top-level directory.
+ */
+
+#if defined(__ARM_NEON__) || defined(__ARM_NEON)
+
+#include <arm_neon.h>
+#include "../filters_int.h"
+
+#define U16(v)		vreinterpretq_u16_u8(v)
+#define U8(v)		vreinterpretq_u8_u16(v)
+
+#define V		uint8x16_t
+#define VB		16
+#define V_ATTR
+#define V_LOAD(p)	vld1q_u8((const uint8_t *)(p))
+#define V_STORE(p, v)	vst1q_u8((uint8_t *)(p), v)
+#define V_CMPEQ8	vceqq_u8
+#define V_CMPEQ16(a, b)	U8(vceqq_u16(U16(a), U16(b)))
+#define V_AND		vandq_u8
+#define V_OR		vorrq_u8
+#define V_ANDNOT(a, b)	vbicq_u8(b, a)
+#define V_SEL		vbslq_u8
+#define V_ZIP8(a, b, lo, hi) { \
+	uint8x16x2_t z_ = vzipq_u8(a, b); \
+	lo = z_.val[0]; \
+	hi = z_.val[1]; \
+}
+#define V_ZIP16(a, b, lo, hi) { \
+	uint16x8x2_t z_ = vzipq_u16(U16(a), U16(b)); \
+	lo = U8(z_.val[0]); \
+	hi = U8(z_.val[1]); \
+}
+#define V_STORE3_8(p, a, b, c) { \
+	uint8x16x3_t s_; \
+	s_.val[0] = a; \
+	s_.val[1] = b; \
+	s_.val[2] = c; \
+	vst3q_u8((uint8_t *)(p), s_); \
+}
+#define V_STORE3_16(p, a, b, c) { \
+	uint16x8x3_t s_; \
+	s_.val[0] = U16(a); \
+	s_.val[1] = U16(b); \
+	s_.val[2] = U16(c); \
+	vst3q_u16((uint16_t *)(p), s_); \
+}
+#define V_LINES		filter_lines_neon
+
+#include "../filters_tmpl.h"
+
+#endif
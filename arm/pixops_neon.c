@@ -0,0 +1,65 @@
+/*
+ * pixel kernels, NEON intrinsics
+ * (on 32bit ARM this needs -mfpu=neon, for this file only is fine)
+ *
+ * This work is licensed under the terms of any of these licenses
+ * (at your option):
+ *  - GNU GPL, version 2 or later.
+ *  - GNU LGPL, version 2.1 or later.
+ *  - MAME license.
+ * See the COPYING file in the top-level directory.
+ */
+
+#if defined(__ARM_NEON__) || defined(__ARM_NEON)
+
+#include <arm_neon.h>
+#include "../pixops.h"
+
+void pixops_darken_bg_neon(void *dst, const void *src, int pixels,
+	int darker)
+{
+	const uint32x4_t m1 = vdupq_n_u32(0xf79ef79e);
+	const uint32x4_t m3 = vdupq_n_u32(0xc618c618);
+	uint16_t *d = dst;
+	const uint16_t *s = src;
+	int i;
+
+	for (i = 0; i + 8 <= pixels; i += 8) {
+		uint32x4_t p = vreinterpretq_u32_u16(vld1q_u16(s + i));
+		uint32x4_t r = vshrq_n_u32(vandq_u32(p, m1), 1);
+		if (darker)
+			r = vsubq_u32(r, vshrq_n_u32(vandq_u32(p, m3), 3));
+		vst1q_u16(d + i, vreinterpretq_u16_u32(r));
+	}
+
+	pixops_darken_bg_c(d + i, s + i, pixels - i, darker);
+}
+
+void pixops_rgb565_to_xrgb8888_neon(uint32_t *dst, const uint16_t *src,
+	int pixels)
+{
+	const uint16x8_t mf8 = vdupq_n_u16(0xf8), mfc = vdupq_n_u16(0xfc);
+	const uint16x8_t m7 = vdupq_n_u16(7), m3 = vdupq_n_u16(3);
+	int i;
+
+	for (i = 0; i + 8 <= pixels; i += 8) {
+		uint16x8_t p = vld1q_u16(src + i);
+		uint16x8_t r, g, b, bg;
+		uint16x8x2_t z;
+
+		r = vorrq_u16(vandq_u16(vshrq_n_u16(p, 8), mf8), vshrq_n_u16(p, 13));
+		g = vorrq_u16(vandq_u16(vshrq_n_u16(p, 3), mfc),
+			vandq_u16(vshrq_n_u16(p, 9), m3));
+		b = vorrq_u16(vandq_u16(vshlq_n_u16(p, 3), mf8),
+			vandq_u16(vshrq_n_u16(p, 2), m7));
+		bg = vorrq_u16(b, vshlq_n_u16(g, 8));
+
+		z = vzipq_u16(bg, r);
+		vst1q_u16((uint16_t *)(dst + i), z.val[0]);
+		vst1q_u16((uint16_t *)(dst + i + 4), z.val[1]);
+	}
+
+	pixops_rgb565_to_xrgb8888_c(dst + i, src + i, pixels - i);
+}
+
+#endif
@@ -0,0 +1,852 @@
+/*
+ * scale/eagle/hq filters, C versions and implementation selection
+ *
+ * This work is licensed under the terms of any of these licenses
+ * (at your option):
+ *  - GNU GPL, version 2 or later.
+ *  - GNU LGPL, version 2.1 or later.
+ *  - MAME license.
+ * See the COPYING file in the top-level directory.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "filters.h"
+#include "filters_int.h"
+#include "pixops.h"
+#ifdef HAVE_NEON32
+#include "arm/neon_scale2x.h"
+#include "arm/neon_eagle2x.h"
+#endif
+
+#define FILTER_C_LINE(name, cname, type) \
+static void name(type *d, unsigned int ds, const type *b, \
+	const type *e, const type *h, unsigned int w) \
+{ \
+	cname(d, ds, b, e, h, 0, w, w); \
+}
+
+FILTER_C_LINE(scale2x_line8, scale2x_line8_c, uint8_t)
+FILTER_C_LINE(scale2x_line16, scale2x_line16_c, uint16_t)
+FILTER_C_LINE(eagle2x_line8, eagle2x_line8_c, uint8_t)
+FILTER_C_LINE(eagle2x_line16, eagle2x_line16_c, uint16_t)
+FILTER_C_LINE(scale3x_line8, scale3x_line8_c, uint8_t)
+FILTER_C_LINE(scale3x_line16, scale3x_line16_c, uint16_t)
+FILTER_C_LINE(eagle3x_line8, eagle3x_line8_c, uint8_t)
+FILTER_C_LINE(eagle3x_line16, eagle3x_line16_c, uint16_t)
+
+const struct filter_lines filter_lines_c = {
+	scale2x_line8,
+	scale2x_line16,
+	eagle2x_line8,
+	eagle2x_line16,
+	scale3x_line8,
+	scale3x_line16,
+	eagle3x_line8,
+	eagle3x_line16,
+};
+
+/* no filtering, only pixel duplication, mostly for the _32 outputs */
+#define FILTER_NORMAL_LINES(type, bits) \
+static void normal1x_line##bits(type *d, unsigned int ds, const type *b, \
+	const type *e, const type *h, unsigned int w) \
+{ \
+	memcpy(d, e, w * sizeof(type)); \
+} \
+\
+static void normal2x_line##bits(type *d, unsigned int ds, const type *b, \
+	const type *e, const type *h, unsigned int w) \
+{ \
+	unsigned int x; \
+\
+	for (x = 0; x < w; x++) \
+		d[x * 2] = d[x * 2 + 1] = e[x]; \
+	memcpy(FILTER_LINE(d, 1, ds), d, w * 2 * sizeof(type)); \
+}
+
+FILTER_NORMAL_LINES(uint8_t, 8)
+FILTER_NORMAL_LINES(uint16_t, 16)
+
+static const struct filter_lines *lines = &filter_lines_c;
+static int lines_impl = FILTER_IMPL_C;
+
+/*
+ * HQ2x/HQ3x-class, RGB565 only. Like hqx, neighbours are "different"
+ * when their YUV distance is over a threshold (Y 0x30, U 7, V 6),
+ * but instead of hqx's 256 case tables a few rules are used to blend
+ * the corners (and edge centers for 3x). This is the part that doesn't
+ * vectorize well, so it's C only.
+ */
+static inline int hq_diff(uint16_t a, uint16_t b)
+{
+	int r, g, bl;
+
+	if (a == b)
+		return 0;
+
+	/* differences in 8 bit per channel scale */
+	r = (int)(a >> 11) - (int)(b >> 11);
+	g = (int)((a >> 5) & 0x3f) - (int)((b >> 5) & 0x3f);
+	bl = (int)(a & 0x1f) - (int)(b & 0x1f);
+	r <<= 3; g <<= 2; bl <<= 3;
+
+	/* Y = (r + g + b) / 4, U = (r - b) / 4, V = (2g - r - b) / 8 */
+	return abs(r + g + bl) > 0x30 * 4 || abs(r - bl) > 7 * 4
+		|| abs(2 * g - r - bl) > 6 * 8;
+}
+
+/* (a * wa + b * wb + c * wc) >> shift, weights must sum to 1 << shift <= 32 */
+static inline uint16_t hq_mix(uint16_t a, int wa, uint16_t b, int wb,
+	uint16_t c, int wc, int shift)
+{
+	uint32_t x;
+
+	x  = (((uint32_t)a | ((uint32_t)a << 16)) & 0x07e0f81f) * wa;
+	x += (((uint32_t)b | ((uint32_t)b << 16)) & 0x07e0f81f) * wb;
+	x += (((uint32_t)c | ((uint32_t)c << 16)) & 0x07e0f81f) * wc;
+	x = (x >> shift) & 0x07e0f81f;
+
+	return x | (x >> 16);
+}
+
+/* corner towards sides s1, s2 and diagonal d */
+static inline uint16_t hq_corner(uint16_t e, uint16_t s1, uint16_t s2,
+	uint16_t d)
+{
+	int d1 = hq_diff(e, s1), d2 = hq_diff(e, s2);
+
+	if (d1 && !hq_diff(s1, s2)) {
+		/* edge going across the corner */
+		if (!hq_diff(e, d))
+			return hq_mix(e, 2, s1, 1, s2, 1, 2);
+		return hq_mix(e, 2, s1, 3, s2, 3, 3);
+	}
+	if (d1 && d2)
+		return hq_mix(e, 2, s1, 1, s2, 1, 2);
+	return e;
+}
+
+/* 3x edge center towards side s, a/b are the sides next to s,
+ * da/db diagonals on the other side of s from a/b */
+static inline uint16_t hq_edge(uint16_t e, uint16_t s, uint16_t a,
+	uint16_t da, uint16_t b, uint16_t db)
+{
+	if (hq_diff(e, s) && ((!hq_diff(s, a) && hq_diff(e, da))
+	    || (!hq_diff(s, b) && hq_diff(e, db))))
+		return hq_mix(e, 3, s, 1, s, 0, 2);
+	return e;
+}
+
+#define HQ_LOAD() \
+	unsigned int l = x > 0 ? x - 1 : x; \
+	unsigned int r = x + 1 < w ? x + 1 : x; \
+	uint16_t A = b[l], B = b[x], C = b[r]; \
+	uint16_t D = e[l], E = e[x], F = e[r]; \
+	uint16_t G = h[l], H = h[x], I = h[r]; \
+	int flat = A == E && B == E && C == E && D == E && F == E \
+		&& G == E && H == E && I == E
+
+static void hq2x_line16(uint16_t *d, unsigned int ds, const uint16_t *b,
+	const uint16_t *e, const uint16_t *h, unsigned int w)
+{
+	uint16_t *d1 = FILTER_LINE(d, 1, ds);
+	unsigned int x;
+
+	for (x = 0; x < w; x++) {
+		HQ_LOAD();
+		uint16_t *o0 = d + x * 2, *o1 = d1 + x * 2;
+
+		if (flat) {
+			o0[0] = o0[1] = o1[0] = o1[1] = E;
+			continue;
+		}
+		o0[0] = hq_corner(E, D, B, A);
+		o0[1] = hq_corner(E, B, F, C);
+		o1[0] = hq_corner(E, D, H, G);
+		o1[1] = hq_corner(E, H, F, I);
+	}
+}
+
+static void hq3x_line16(uint16_t *d, unsigned int ds, const uint16_t *b,
+	const uint16_t *e, const uint16_t *h, unsigned int w)
+{
+	uint16_t *d1 = FILTER_LINE(d, 1, ds);
+	uint16_t *d2 = FILTER_LINE(d, 2, ds);
+	unsigned int x;
+
+	for (x = 0; x < w; x++) {
+		HQ_LOAD();
+		uint16_t *o0 = d + x * 3, *o1 = d1 + x * 3, *o2 = d2 + x * 3;
+
+		if (flat) {
+			o0[0] = o0[1] = o0[2] = o1[0] = o1[1] = o1[2] =
+			o2[0] = o2[1] = o2[2] = E;
+			continue;
+		}
+		o0[0] = hq_corner(E, D, B, A);
+		o0[1] = hq_edge(E, B, D, C, F, A);
+		o0[2] = hq_corner(E, B, F, C);
+		o1[0] = hq_edge(E, D, B, G, H, A);
+		o1[1] = E;
+		o1[2] = hq_edge(E, F, B, I, H, C);
+		o2[0] = hq_corner(E, D, H, G);
+		o2[1] = hq_edge(E, H, D, I, F, G);
+		o2[2] = hq_corner(E, H, F, I);
+	}
+}
+
+/* frame loops, source lines [y, y_end) of a height tall frame,
+ * each producing scale output lines */
+static void filter_8_8(filter_line_8 *line, unsigned int scale,
+	const uint8_t *src, uint8_t *dst, unsigned int width,
+	unsigned int srcstride, unsigned int dststride, unsigned int height,
+	unsigned int y, unsigned int y_end)
+{
+	for (; y < y_end; y++) {
+		const uint8_t *e = src + y * srcstride;
+		const uint8_t *b = y > 0 ? e - srcstride : e;
+		const uint8_t *h = y + 1 < height ? e + srcstride : e;
+
+		line(dst + y * scale * dststride, dststride, b, e, h, width);
+	}
+}
+
+static void filter_16_16(filter_line_16 *line, unsigned int scale,
+	const uint16_t *src, uint16_t *dst, unsigned int width,
+	unsigned int srcstride, unsigned int dststride, unsigned int height,
+	unsigned int y, unsigned int y_end)
+{
+	for (; y < y_end; y++) {
+		const uint16_t *e = FILTER_LINE(src, y, srcstride);
+		const uint16_t *b = y > 0 ? FILTER_LINE(src, y - 1, srcstride) : e;
+		const uint16_t *h = y + 1 < height ? FILTER_LINE(src, y + 1, srcstride) : e;
+
+		line(FILTER_LINE(dst, y * scale, dststride), dststride, b, e, h, width);
+	}
+}
+
+static void pal_line_8_16(uint16_t *d, const uint8_t *s,
+	const uint32_t *pal, unsigned int w)
+{
+	unsigned int x;
+
+	for (x = 0; x < w; x++)
+		d[x] = pal[s[x]];
+}
+
+/* like the asm, palette is applied to 3 temporary lines first */
+static void filter_8_16(filter_line_16 *line, unsigned int scale,
+	const uint8_t *src, uint16_t *dst, const uint32_t *pal,
+	unsigned int width, unsigned int srcstride, unsigned int dststride,
+	unsigned int height, unsigned int y, unsigned int y_end)
+{
+	uint16_t buf[width * 3];
+	uint16_t *b = buf, *e = buf + width, *h = buf + width * 2, *t;
+
+	if (y >= y_end)
+		return;
+
+	pal_line_8_16(e, src + y * srcstride, pal, width);
+	if (y > 0)
+		pal_line_8_16(b, src + (y - 1) * srcstride, pal, width);
+
+	for (; y < y_end; y++) {
+		if (y + 1 < height)
+			pal_line_8_16(h, src + (y + 1) * srcstride, pal, width);
+
+		line(FILTER_LINE(dst, y * scale, dststride), dststride,
+			y > 0 ? b : e, e, y + 1 < height ? h : e, width);
+
+		t = b; b = e; e = h; h = t;
+	}
+}
+
+static void pal_line_8_32(uint32_t *d, const uint8_t *s,
+	const uint32_t *pal, unsigned int w)
+{
+	unsigned int x;
+
+	for (x = 0; x < w; x++)
+		d[x] = pal[s[x]];
+}
+
+static void conv_line_16_32(uint32_t *d, const uint16_t *s, unsigned int w)
+{
+	pixops.rgb565_to_xrgb8888(d, s, w);
+}
+
+/*
+ * 32bpp output: the 8/16bpp kernel fills a few temporary lines that
+ * stay in cache, those are converted straight to dst. Scaling is done
+ * on the narrow pixels and dst is only written once.
+ */
+/*
+ * Maps palette indexes to the first index with the same colour, so
+ * that the 8bpp kernels compare resolved colours like _8_16 does
+ * (palettes often repeat colours under different indexes).
+ */
+static void pal_canon(uint8_t *canon, const uint32_t *pal)
+{
+	uint16_t slot[512];	/* index + 1, 0 if free */
+	unsigned int i, h;
+
+	memset(slot, 0, sizeof(slot));
+	for (i = 0; i < 256; i++) {
+		h = (pal[i] * 0x9e3779b1) >> 23;
+		while (slot[h] != 0 && pal[slot[h] - 1] != pal[i])
+			h = (h + 1) & 511;
+		if (slot[h] == 0)
+			slot[h] = i + 1;
+		canon[i] = slot[h] - 1;
+	}
+}
+
+static void canon_line(uint8_t *d, const uint8_t *s, const uint8_t *canon,
+	unsigned int w)
+{
+	unsigned int x;
+
+	for (x = 0; x < w; x++)
+		d[x] = canon[s[x]];
+}
+
+static void filter_8_32(filter_line_8 *line, unsigned int scale,
+	const uint8_t *src, uint32_t *dst, const uint32_t *pal,
+	unsigned int width, unsigned int srcstride, unsigned int dststride,
+	unsigned int height, unsigned int y, unsigned int y_end)
+{
+	unsigned int ow = width * scale;
+	uint8_t tmp[ow * scale];
+	uint8_t buf[width * 3], canon[256];
+	uint8_t *b = buf, *e = buf + width, *h = buf + width * 2, *t;
+	unsigned int i;
+
+	if (y >= y_end)
+		return;
+
+	pal_canon(canon, pal);
+	canon_line(e, src + y * srcstride, canon, width);
+	if (y > 0)
+		canon_line(b, src + (y - 1) * srcstride, canon, width);
+
+	for (; y < y_end; y++) {
+		if (y + 1 < height)
+			canon_line(h, src + (y + 1) * srcstride, canon, width);
+
+		line(tmp, ow, y > 0 ? b : e, e, y + 1 < height ? h : e, width);
+		for (i = 0; i < scale; i++)
+			pal_line_8_32(FILTER_LINE(dst, y * scale + i, dststride),
+				tmp + i * ow, pal, ow);
+
+		t = b; b = e; e = h; h = t;
+	}
+}
+
+static void filter_16_32(filter_line_16 *line, unsigned int scale,
+	const uint16_t *src, uint32_t *dst, unsigned int width,
+	unsigned int srcstride, unsigned int dststride, unsigned int height,
+	unsigned int y, unsigned int y_end)
+{
+	unsigned int ow = width * scale;
+	uint16_t tmp[ow * scale];
+	unsigned int i;
+
+	for (; y < y_end; y++) {
+		const uint16_t *e = FILTER_LINE(src, y, srcstride);
+		const uint16_t *b = y > 0 ? FILTER_LINE(src, y - 1, srcstride) : e;
+		const uint16_t *h = y + 1 < height ? FILTER_LINE(src, y + 1, srcstride) : e;
+
+		line(tmp, ow * sizeof(tmp[0]), b, e, h, width);
+		for (i = 0; i < scale; i++)
+			conv_line_16_32(FILTER_LINE(dst, y * scale + i, dststride),
+				tmp + i * ow, ow);
+	}
+}
+
+/*
+ * per-thread scratch for the 4x kernels; it only grows, so it's
+ * allocated on the first frame and reused after that
+ */
+static __thread void *scratch;
+static __thread size_t scratch_size;
+
+static void *filter_scratch(size_t size)
+{
+	void *p;
+
+	if (size <= scratch_size)
+		return scratch;
+
+	p = realloc(scratch, size);
+	if (p == NULL) {
+		fprintf(stderr, "filters: OOM\n");
+		return NULL;
+	}
+	scratch = p;
+	scratch_size = size;
+	return p;
+}
+
+void filter_scratch_free(void)
+{
+	free(scratch);
+	scratch = NULL;
+	scratch_size = 0;
+}
+
+/* 2x line pairs of 3 source lines */
+#define FILTER4X_BUF(width) ((width) * 2 * 2 * 3)
+
+/*
+ * 4x is 2x done twice. The 2x lines of the previous, current and next
+ * source line are kept in a ring (pairs p, c, n), so that each 2x line
+ * is only made once while going down the band.
+ */
+#define FILTER4X(name, type, ltype) \
+static void name##_pair(ltype *line, type *d, unsigned int ds, \
+	const type *src, unsigned int width, unsigned int srcstride, \
+	unsigned int height, unsigned int y) \
+{ \
+	const type *e = FILTER_LINE(src, y, srcstride); \
+	const type *b = y > 0 ? FILTER_LINE(src, y - 1, srcstride) : e; \
+	const type *h = y + 1 < height ? FILTER_LINE(src, y + 1, srcstride) : e; \
+\
+	line(d, ds, b, e, h, width); \
+} \
+\
+static void name(ltype *line, const type *src, type *dst, type *buf, \
+	unsigned int width, unsigned int srcstride, unsigned int dststride, \
+	unsigned int height, unsigned int y, unsigned int y_end) \
+{ \
+	unsigned int ms = width * 2 * sizeof(type); \
+	type *p = buf, *c = buf + width * 4, *n = buf + width * 8, *t; \
+\
+	if (y >= y_end) \
+		return; \
+\
+	name##_pair(line, c, ms, src, width, srcstride, height, y); \
+	if (y > 0) \
+		name##_pair(line, p, ms, src, width, srcstride, height, y - 1); \
+\
+	for (; y < y_end; y++) { \
+		type *d = FILTER_LINE(dst, y * 4, dststride); \
+		type *c1 = FILTER_LINE(c, 1, ms); \
+		const type *mb = y > 0 ? FILTER_LINE(p, 1, ms) : c; \
+		const type *mh = y + 1 < height ? n : c1; \
+\
+		if (y + 1 < height) \
+			name##_pair(line, n, ms, src, width, srcstride, height, y + 1); \
+\
+		line(d, dststride, mb, c, c1, width * 2); \
+		line(FILTER_LINE(d, 2, dststride), dststride, c, c1, mh, width * 2); \
+\
+		t = p; p = c; c = n; n = t; \
+	} \
+}
+
+FILTER4X(filter4x_8_8, uint8_t, filter_line_8)
+FILTER4X(filter4x_16_16, uint16_t, filter_line_16)
+
+/* palette is applied to the band and 2 lines around it, which
+ * is all the context the 2 passes need */
+static void filter4x_8_16(filter_line_16 *line, const uint8_t *src,
+	uint16_t *dst, const uint32_t *pal, unsigned int width,
+	unsigned int srcstride, unsigned int dststride, unsigned int height,
+	unsigned int y, unsigned int y_end)
+{
+	unsigned int y0 = y > 2 ? y - 2 : 0;
+	unsigned int y1 = y_end + 2 < height ? y_end + 2 : height;
+	uint16_t *tmp;
+	unsigned int i;
+
+	if (y >= y_end)
+		return;
+
+	tmp = filter_scratch(((y1 - y0) * width + FILTER4X_BUF(width))
+		* sizeof(tmp[0]));
+	if (tmp == NULL)
+		return;
+
+	for (i = y0; i < y1; i++)
+		pal_line_8_16(tmp + (i - y0) * width, src + i * srcstride, pal, width);
+
+	filter4x_16_16(line, tmp, FILTER_LINE(dst, y0 * 4, dststride),
+		tmp + (y1 - y0) * width, width, width * sizeof(tmp[0]),
+		dststride, y1 - y0, y - y0, y_end - y0);
+}
+
+static void filter_job_range(const struct filter_job *job, unsigned int y,
+	unsigned int y_end)
+{
+	filter_line_8 *line8 = NULL;
+	filter_line_16 *line16;
+	unsigned int scale;
+	void *buf;
+
+	switch (job->filter) {
+	case FILTER_NORMAL1X:
+		line8 = normal1x_line8;
+		line16 = normal1x_line16;
+		scale = 1;
+		break;
+	case FILTER_NORMAL2X:
+		line8 = normal2x_line8;
+		line16 = normal2x_line16;
+		scale = 2;
+		break;
+	case FILTER_SCALE2X:
+	case FILTER_SCALE4X:
+		line8 = lines->scale2x_8;
+		line16 = lines->scale2x_16;
+		scale = job->filter == FILTER_SCALE4X ? 4 : 2;
+		break;
+	case FILTER_EAGLE2X:
+	case FILTER_EAGLE4X:
+		line8 = lines->eagle2x_8;
+		line16 = lines->eagle2x_16;
+		scale = job->filter == FILTER_EAGLE4X ? 4 : 2;
+		break;
+	case FILTER_SCALE3X:
+		line8 = lines->scale3x_8;
+		line16 = lines->scale3x_16;
+		scale = 3;
+		break;
+	case FILTER_EAGLE3X:
+		line8 = lines->eagle3x_8;
+		line16 = lines->eagle3x_16;
+		scale = 3;
+		break;
+	case FILTER_HQ2X:
+		line16 = hq2x_line16;
+		scale = 2;
+		break;
+	case FILTER_HQ3X:
+		line16 = hq3x_line16;
+		scale = 3;
+		break;
+	default:
+		return;
+	}
+
+	switch (job->format) {
+	case FILTER_FMT_8_8:
+		if (line8 == NULL)
+			break;
+		if (scale == 4) {
+			buf = filter_scratch(FILTER4X_BUF(job->width));
+			if (buf != NULL)
+				filter4x_8_8(line8, job->src, job->dst, buf,
+					job->width, job->srcstride, job->dststride,
+					job->height, y, y_end);
+		}
+		else
+			filter_8_8(line8, scale, job->src, job->dst, job->width,
+				job->srcstride, job->dststride, job->height, y, y_end);
+		break;
+	case FILTER_FMT_16_16:
+		if (scale == 4) {
+			buf = filter_scratch(FILTER4X_BUF(job->width) * 2);
+			if (buf != NULL)
+				filter4x_16_16(line16, job->src, job->dst, buf,
+					job->width, job->srcstride, job->dststride,
+					job->height, y, y_end);
+		}
+		else
+			filter_16_16(line16, scale, job->src, job->dst, job->width,
+				job->srcstride, job->dststride, job->height, y, y_end);
+		break;
+	case FILTER_FMT_8_16:
+		if (scale == 4)
+			filter4x_8_16(line16, job->src, job->dst, job->palette,
+				job->width, job->srcstride, job->dststride,
+				job->height, y, y_end);
+		else
+			filter_8_16(line16, scale, job->src, job->dst, job->palette,
+				job->width, job->srcstride, job->dststride,
+				job->height, y, y_end);
+		break;
+	case FILTER_FMT_8_32:
+		if (line8 == NULL || scale == 4)
+			break;
+		filter_8_32(line8, scale, job->src, job->dst, job->palette,
+			job->width, job->srcstride, job->dststride,
+			job->height, y, y_end);
+		break;
+	case FILTER_FMT_16_32:
+		if (scale == 4)
+			break;
+		filter_16_32(line16, scale, job->src, job->dst, job->width,
+			job->srcstride, job->dststride, job->height, y, y_end);
+		break;
+	}
+}
+
+static int line_dirty(const uint32_t *dirty, unsigned int y)
+{
+	return (dirty[y / 32] >> (y & 31)) & 1;
+}
+
+/* does output of line y depend on any dirty lines? 4x looks 2 lines away */
+static int area_dirty(const struct filter_job *job, unsigned int y)
+{
+	unsigned int r = (job->filter == FILTER_SCALE4X
+		|| job->filter == FILTER_EAGLE4X) ? 2 : 1;
+	unsigned int i = y > r ? y - r : 0;
+	unsigned int i_end = y + r < job->height ? y + r + 1 : job->height;
+
+	for (; i < i_end; i++)
+		if (line_dirty(job->dirty, i))
+			return 1;
+	return 0;
+}
+
+void filter_job_lines(const struct filter_job *job, unsigned int y,
+	unsigned int y_end)
+{
+	unsigned int start;
+
+	if (y_end > job->height)
+		y_end = job->height;
+
+	if (job->dirty == NULL) {
+		filter_job_range(job, y, y_end);
+		return;
+	}
+
+	/* filter runs of lines, so the line kernels don't lose their
+	 * neighbour line caching (palette lines, 4x pairs) */
+	while (y < y_end) {
+		while (y < y_end && !area_dirty(job, y))
+			y++;
+		start = y;
+		while (y < y_end && area_dirty(job, y))
+			y++;
+		if (start < y)
+			filter_job_range(job, start, y);
+	}
+}
+
+static uint32_t line_hash(const uint8_t *p, unsigned int bytes)
+{
+	uint32_t h = 0x811c9dc5, v;
+	unsigned int i;
+
+	for (i = 0; i + 4 <= bytes; i += 4) {
+		memcpy(&v, p + i, 4);
+		h = (h ^ v) * 0x9e3779b1;
+		h ^= h >> 15;
+	}
+	for (; i < bytes; i++)
+		h = (h ^ p[i]) * 0x01000193;
+
+	/* 0 is left for "no hash yet" */
+	return h != 0 ? h : 1;
+}
+
+int filter_dirty_hash(const struct filter_job *job, uint32_t *hashes,
+	uint32_t *dirty)
+{
+	unsigned int bytes = job->width, y;
+	int changed = 0;
+	uint32_t h;
+
+	if (job->format == FILTER_FMT_16_16 || job->format == FILTER_FMT_16_32)
+		bytes *= 2;
+
+	memset(dirty, 0, FILTER_DIRTY_WORDS(job->height) * sizeof(dirty[0]));
+	for (y = 0; y < job->height; y++) {
+		h = line_hash((const uint8_t *)job->src + y * job->srcstride, bytes);
+		if (h != hashes[y]) {
+			hashes[y] = h;
+			dirty[y / 32] |= 1u << (y & 31);
+			changed++;
+		}
+	}
+
+	return changed;
+}
+
+static void filter_frame(int filter, int format, const void *src, void *dst,
+	const uint32_t *palette, unsigned int width, unsigned int srcstride,
+	unsigned int dststride, unsigned int height)
+{
+	struct filter_job job;
+
+#ifdef HAVE_NEON32
+	/* whole frames can go to the hand scheduled asm, it wants
+	 * at least 3 lines and a 16 byte block in each */
+	if (lines_impl == FILTER_IMPL_NEON && height >= 3
+	    && (filter == FILTER_SCALE2X || filter == FILTER_EAGLE2X)
+	    && width * (format == FILTER_FMT_16_16 ? 2 : 1) >= 16) {
+		int sc = filter == FILTER_SCALE2X;
+
+		switch (format) {
+		case FILTER_FMT_8_8:
+			(sc ? neon_scale2x_8_8 : neon_eagle2x_8_8)(src, dst,
+				width, srcstride, dststride, height);
+			return;
+		case FILTER_FMT_16_16:
+			(sc ? neon_scale2x_16_16 : neon_eagle2x_16_16)(src, dst,
+				width, srcstride, dststride, height);
+			return;
+		case FILTER_FMT_8_16:
+			(sc ? neon_scale2x_8_16 : neon_eagle2x_8_16)(src, dst,
+				palette, width, srcstride, dststride, height);
+			return;
+		}
+	}
+#endif
+
+	memset(&job, 0, sizeof(job));
+	job.filter = filter;
+	job.format = format;
+	job.src = src;
+	job.dst = dst;
+	job.palette = palette;
+	job.width = width;
+	job.srcstride = srcstride;
+	job.dststride = dststride;
+	job.height = height;
+	filter_job_lines(&job, 0, height);
+}
+
+#define FILTER_FRAME_FUNCS(name, filter) \
+void name##_8_8(const uint8_t *src, uint8_t *dst, unsigned int width, \
+	unsigned int srcstride, unsigned int dststride, unsigned int height) \
+{ \
+	filter_frame(filter, FILTER_FMT_8_8, src, dst, NULL, width, \
+		srcstride, dststride, height); \
+} \
+\
+FILTER_FRAME_FUNCS_16(name, filter)
+
+#define FILTER_FRAME_FUNCS_16(name, filter) \
+void name##_16_16(const uint16_t *src, uint16_t *dst, unsigned int width, \
+	unsigned int srcstride, unsigned int dststride, unsigned int height) \
+{ \
+	filter_frame(filter, FILTER_FMT_16_16, src, dst, NULL, width, \
+		srcstride, dststride, height); \
+} \
+\
+void name##_8_16(const uint8_t *src, uint16_t *dst, \
+	const uint32_t *palette, unsigned int width, unsigned int srcstride, \
+	unsigned int dststride, unsigned int height) \
+{ \
+	filter_frame(filter, FILTER_FMT_8_16, src, dst, palette, width, \
+		srcstride, dststride, height); \
+}
+
+#define FILTER_FRAME_FUNCS_32(name, filter) \
+void name##_8_32(const uint8_t *src, uint32_t *dst, \
+	const uint32_t *palette, unsigned int width, unsigned int srcstride, \
+	unsigned int dststride, unsigned int height) \
+{ \
+	filter_frame(filter, FILTER_FMT_8_32, src, dst, palette, width, \
+		srcstride, dststride, height); \
+} \
+\
+void name##_16_32(const uint16_t *src, uint32_t *dst, unsigned int width, \
+	unsigned int srcstride, unsigned int dststride, unsigned int height) \
+{ \
+	filter_frame(filter, FILTER_FMT_16_32, src, dst, NULL, width, \
+		srcstride, dststride, height); \
+}
+
+FILTER_FRAME_FUNCS(normal1x, FILTER_NORMAL1X)
+FILTER_FRAME_FUNCS(normal2x, FILTER_NORMAL2X)
+FILTER_FRAME_FUNCS(scale2x, FILTER_SCALE2X)
+FILTER_FRAME_FUNCS(eagle2x, FILTER_EAGLE2X)
+FILTER_FRAME_FUNCS(scale3x, FILTER_SCALE3X)
+FILTER_FRAME_FUNCS(eagle3x, FILTER_EAGLE3X)
+FILTER_FRAME_FUNCS(scale4x, FILTER_SCALE4X)
+FILTER_FRAME_FUNCS(eagle4x, FILTER_EAGLE4X)
+FILTER_FRAME_FUNCS_16(hq2x, FILTER_HQ2X)
+FILTER_FRAME_FUNCS_16(hq3x, FILTER_HQ3X)
+FILTER_FRAME_FUNCS_32(normal1x, FILTER_NORMAL1X)
+FILTER_FRAME_FUNCS_32(normal2x, FILTER_NORMAL2X)
+FILTER_FRAME_FUNCS_32(scale2x, FILTER_SCALE2X)
+FILTER_FRAME_FUNCS_32(eagle2x, FILTER_EAGLE2X)
+FILTER_FRAME_FUNCS_32(scale3x, FILTER_SCALE3X)
+FILTER_FRAME_FUNCS_32(eagle3x, FILTER_EAGLE3X)
+
+static int impl_supported(int impl)
+{
+	unsigned int features = pixops_cpu_features();
+
+	switch (impl) {
+	case FILTER_IMPL_C:
+		return 1;
+#if defined(__i386__) || defined(__x86_64__)
+	case FILTER_IMPL_SSE2:
+		return !!(features & PIXOPS_CPU_SSE2);
+	case FILTER_IMPL_AVX2:
+		return !!(features & PIXOPS_CPU_AVX2);
+#endif
+#ifdef FILTERS_NEON
+	case FILTER_IMPL_NEON:
+		return !!(features & PIXOPS_CPU_NEON);
+#endif
+	default:
+		return 0;
+	}
+}
+
+int filters_set_impl(int impl)
+{
+	if (!impl_supported(impl))
+		return -1;
+
+	switch (impl) {
+#if defined(__i386__) || defined(__x86_64__)
+	case FILTER_IMPL_SSE2:
+		lines = &filter_lines_sse2;
+		break;
+	case FILTER_IMPL_AVX2:
+		lines = &filter_lines_avx2;
+		break;
+#endif
+#ifdef FILTERS_NEON
+	case FILTER_IMPL_NEON:
+		lines = &filter_lines_neon;
+		break;
+#endif
+	default:
+		lines = &filter_lines_c;
+		break;
+	}
+	lines_impl = impl;
+
+	return impl;
+}
+
+int filters_get_impl(void)
+{
+	return lines_impl;
+}
+
+const char *filters_impl_name(int impl)
+{
+	static const char * const names[FILTER_IMPL_COUNT] = {
+		"C", "SSE2", "AVX2", "NEON",
+	};
+
+	if ((unsigned int)impl >= FILTER_IMPL_COUNT)
+		return NULL;
+	return names[impl];
+}
+
+int filters_init(void)
+{
+	int impl;
+
+	for (impl = FILTER_IMPL_COUNT - 1; impl > FILTER_IMPL_C; impl--)
+		if (impl_supported(impl))
+			break;
+
+	filters_set_impl(impl);
+	fprintf(stderr, "filters: using %s\n", filters_impl_name(impl));
+
+	return impl;
+}
@@ -0,0 +1,165 @@
+#ifndef LIBPICOFE_FILTERS_H
+#define LIBPICOFE_FILTERS_H
+
+#include <inttypes.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/*
+ * scale/eagle 2x, 3x and 4x filters, same interface as arm/neon_scale2x.h
+ * and arm/neon_eagle2x.h (strides are in bytes). These run the best
+ * implementation selected by filters_init(), plain C until it's called.
+ * On x86 hosts x86/filters_sse2.c and x86/filters_avx2.c must be linked in,
+ * on ARM with NEON arm/filters_neon.c.
+ */
+void scale2x_8_8(const uint8_t *src, uint8_t *dst, unsigned int width, unsigned int srcstride, unsigned int dststride, unsigned int height);
+void scale2x_16_16(const uint16_t *src, uint16_t *dst, unsigned int width, unsigned int srcstride, unsigned int dststride, unsigned int height);
+void scale2x_8_16(const uint8_t *src, uint16_t *dst, const uint32_t *palette, unsigned int width, unsigned int srcstride, unsigned int dststride, unsigned int height);
+
+void eagle2x_8_8(const uint8_t *src, uint8_t *dst, unsigned int width, unsigned int srcstride, unsigned int dststride, unsigned int height);
+void eagle2x_16_16(const uint16_t *src, uint16_t *dst, unsigned int width, unsigned int srcstride, unsigned int dststride, unsigned int height);
+void eagle2x_8_16(const uint8_t *src, uint16_t *dst, const uint32_t *palette, unsigned int width, unsigned int srcstride, unsigned int dststride, unsigned int height);
+
+void scale3x_8_8(const uint8_t *src, uint8_t *dst, unsigned int width, unsigned int srcstride, unsigned int dststride, unsigned int height);
+void scale3x_16_16(const uint16_t *src, uint16_t *dst, unsigned int width, unsigned int srcstride, unsigned int dststride, unsigned int height);
+void scale3x_8_16(const uint8_t *src, uint16_t *dst, const uint32_t *palette, unsigned int width, unsigned int srcstride, unsigned int dststride, unsigned int height);
+
+/* eagle2x corners, with edges following when both of their corners do */
+void eagle3x_8_8(const uint8_t *src, uint8_t *dst, unsigned int width, unsigned int srcstride, unsigned int dststride, unsigned int height);
+void eagle3x_16_16(const uint16_t *src, uint16_t *dst, unsigned int width, unsigned int srcstride, unsigned int dststride, unsigned int height);
+void eagle3x_8_16(const uint8_t *src, uint16_t *dst, const uint32_t *palette, unsigned int width, unsigned int srcstride, unsigned int dststride, unsigned int height);
+
+/* 4x versions are the 2x filter applied twice */
+void scale4x_8_8(const uint8_t *src, uint8_t *dst, unsigned int width, unsigned int srcstride, unsigned int dststride, unsigned int height);
+void scale4x_16_16(const uint16_t *src, uint16_t *dst, unsigned int width, unsigned int srcstride, unsigned int dststride, unsigned int height);
+void scale4x_8_16(const uint8_t *src, uint16_t *dst, const uint32_t *palette, unsigned int width, unsigned int srcstride, unsigned int dststride, unsigned int height);
+
+void eagle4x_8_8(const uint8_t *src, uint8_t *dst, unsigned int width, unsigned int srcstride, unsigned int dststride, unsigned int height);
+void eagle4x_16_16(const uint16_t *src, uint16_t *dst, unsigned int width, unsigned int srcstride, unsigned int dststride, unsigned int height);
+void eagle4x_8_16(const uint8_t *src, uint16_t *dst, const uint32_t *palette, unsigned int width, unsigned int srcstride, unsigned int dststride, unsigned int height);
+
+/*
+ * XRGB8888 outputs, filtering and conversion in one pass. For _8_32
+ * the palette holds XRGB8888 entries, _16_32 takes RGB565 input.
+ * normal1x/2x don't filter, they only convert (and double the pixels).
+ * There are no 4x versions.
+ */
+void normal1x_8_32(const uint8_t *src, uint32_t *dst, const uint32_t *palette, unsigned int width, unsigned int srcstride, unsigned int dststride, unsigned int height);
+void normal1x_16_32(const uint16_t *src, uint32_t *dst, unsigned int width, unsigned int srcstride, unsigned int dststride, unsigned int height);
+void normal2x_8_32(const uint8_t *src, uint32_t *dst, const uint32_t *palette, unsigned int width, unsigned int srcstride, unsigned int dststride, unsigned int height);
+void normal2x_16_32(const uint16_t *src, uint32_t *dst, unsigned int width, unsigned int srcstride, unsigned int dststride, unsigned int height);
+void scale2x_8_32(const uint8_t *src, uint32_t *dst, const uint32_t *palette, unsigned int width, unsigned int srcstride, unsigned int dststride, unsigned int height);
+void scale2x_16_32(const uint16_t *src, uint32_t *dst, unsigned int width, unsigned int srcstride, unsigned int dststride, unsigned int height);
+void eagle2x_8_32(const uint8_t *src, uint32_t *dst, const uint32_t *palette, unsigned int width, unsigned int srcstride, unsigned int dststride, unsigned int height);
+void eagle2x_16_32(const uint16_t *src, uint32_t *dst, unsigned int width, unsigned int srcstride, unsigned int dststride, unsigned int height);
+void scale3x_8_32(const uint8_t *src, uint32_t *dst, const uint32_t *palette, unsigned int width, unsigned int srcstride, unsigned int dststride, unsigned int height);
+void scale3x_16_32(const uint16_t *src, uint32_t *dst, unsigned int width, unsigned int srcstride, unsigned int dststride, unsigned int height);
+void eagle3x_8_32(const uint8_t *src, uint32_t *dst, const uint32_t *palette, unsigned int width, unsigned int srcstride, unsigned int dststride, unsigned int height);
+void eagle3x_16_32(const uint16_t *src, uint32_t *dst, unsigned int width, unsigned int srcstride, unsigned int dststride, unsigned int height);
+
+/* plain palette conversion / pixel doubling */
+void normal1x_8_8(const uint8_t *src, uint8_t *dst, unsigned int width, unsigned int srcstride, unsigned int dststride, unsigned int height);
+void normal1x_16_16(const uint16_t *src, uint16_t *dst, unsigned int width, unsigned int srcstride, unsigned int dststride, unsigned int height);
+void normal1x_8_16(const uint8_t *src, uint16_t *dst, const uint32_t *palette, unsigned int width, unsigned int srcstride, unsigned int dststride, unsigned int height);
+void normal2x_8_8(const uint8_t *src, uint8_t *dst, unsigned int width, unsigned int srcstride, unsigned int dststride, unsigned int height);
+void normal2x_16_16(const uint16_t *src, uint16_t *dst, unsigned int width, unsigned int srcstride, unsigned int dststride, unsigned int height);
+void normal2x_8_16(const uint8_t *src, uint16_t *dst, const uint32_t *palette, unsigned int width, unsigned int srcstride, unsigned int dststride, unsigned int height);
+
+/*
+ * HQ2x/HQ3x-class filters, these blend colors so there are only
+ * RGB565 outputs. Simplified rules instead of hqx tables, C only.
+ */
+void hq2x_16_16(const uint16_t *src, uint16_t *dst, unsigned int width, unsigned int srcstride, unsigned int dststride, unsigned int height);
+void hq2x_8_16(const uint8_t *src, uint16_t *dst, const uint32_t *palette, unsigned int width, unsigned int srcstride, unsigned int dststride, unsigned int height);
+void hq3x_16_16(const uint16_t *src, uint16_t *dst, unsigned int width, unsigned int srcstride, unsigned int dststride, unsigned int height);
+void hq3x_8_16(const uint8_t *src, uint16_t *dst, const uint32_t *palette, unsigned int width, unsigned int srcstride, unsigned int dststride, unsigned int height);
+
+/* generic interface, mostly for the threaded driver */
+enum {
+	FILTER_SCALE2X = 0,
+	FILTER_EAGLE2X,
+	FILTER_SCALE3X,
+	FILTER_EAGLE3X,
+	FILTER_SCALE4X,
+	FILTER_EAGLE4X,
+	FILTER_HQ2X,	/* no FILTER_FMT_8_8, FILTER_FMT_8_32 */
+	FILTER_HQ3X,
+	FILTER_NORMAL1X,
+	FILTER_NORMAL2X,
+};
+
+enum {
+	FILTER_FMT_8_8 = 0,
+	FILTER_FMT_16_16,
+	FILTER_FMT_8_16,
+	FILTER_FMT_8_32,	/* XRGB8888 palette */
+	FILTER_FMT_16_32,	/* RGB565 -> XRGB8888 */
+};
+
+/* zero-init before filling in, so that optional fields are unset */
+struct filter_job {
+	int filter;		/* FILTER_* */
+	int format;		/* FILTER_FMT_* */
+	const void *src;
+	void *dst;
+	const uint32_t *palette;	/* for FILTER_FMT_8_16, FILTER_FMT_8_32 */
+	unsigned int width;
+	unsigned int srcstride;
+	unsigned int dststride;
+	unsigned int height;
+	const uint32_t *dirty;	/* optional, see below */
+};
+
+/* filter source lines [y, y_end) of the job's frame,
+ * lines outside of that range are only read as neighbours */
+void filter_job_lines(const struct filter_job *job, unsigned int y, unsigned int y_end);
+
+/*
+ * dirty line tracking: if job->dirty is set, it's a bitmap of source
+ * lines that changed since the last frame (bit y & 31 of word y / 32),
+ * and only lines that have a changed line within their neighbourhood
+ * are filtered. Everything else is assumed to already be in dst from
+ * the previous frame, so dst must not change between frames (no
+ * flipping directly into it) and a palette change needs a full frame.
+ * The bitmap can come from the emulator, or filter_dirty_hash() can
+ * make it by comparing line hashes with the ones from the previous call
+ * (hashes must hold job->height values, zeroed before the first call;
+ * no line hashes to 0, so zeroed lines all count as changed).
+ * Returns the number of changed lines.
+ */
+#define FILTER_DIRTY_WORDS(height) (((height) + 31) / 32)
+int filter_dirty_hash(const struct filter_job *job, uint32_t *hashes, uint32_t *dirty);
+
+/*
+ * threaded driver: a frame is split in horizontal bands, one per worker.
+ * Workers stay alive between frames, so the usual sequence is
+ * filter_threads_start(), (other work), filter_threads_wait(),
+ * plat_video_flip(). count 0 means one worker per online CPU.
+ */
+int  filter_threads_init(int count);
+void filter_threads_start(const struct filter_job *job);
+void filter_threads_wait(void);
+void filter_threads_finish(void);
+
+enum {
+	FILTER_IMPL_C = 0,
+	FILTER_IMPL_SSE2,
+	FILTER_IMPL_AVX2,
+	FILTER_IMPL_NEON,
+	FILTER_IMPL_COUNT
+};
+
+/* pick the fastest implementation this CPU can run, returns FILTER_IMPL_* */
+int  filters_init(void);
+/* force some implementation, -1 if it's not available on this CPU */
+int  filters_set_impl(int impl);
+int  filters_get_impl(void);
+const char *filters_impl_name(int impl);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* LIBPICOFE_FILTERS_H */
@@ -0,0 +1,817 @@
+/*
+ * filter benchmark, a standalone program:
+ * gcc -O2 -o filters_bench filters_bench.c filters.c filters_mt.c pixops.c \
+ *   fonts.c x86/filters_sse2.c x86/filters_avx2.c x86/pixops_sse2.c -lpthread
+ * add -DBENCH_PNG readpng.c -lpng to allow frames from .png files,
+ * for ARM replace x86/ files with arm/filters_neon.c arm/pixops_neon.c
+ * (-mfpu=neon),
+ * and add -DHAVE_NEON32 arm/neon_scale2x.S arm/neon_eagle2x.S
+ * to also measure the asm versions.
+ * With -check it's a conformance test instead, on ARM it can be run
+ * with qemu-user, like: qemu-arm -L /usr/arm-linux-gnueabihf ./filters_bench -check
+ *
+ * This work is licensed under the terms of any of these licenses
+ * (at your option):
+ *  - GNU GPL, version 2 or later.
+ *  - GNU LGPL, version 2.1 or later.
+ *  - MAME license.
+ * See the COPYING file in the top-level directory.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdarg.h>
+#include <time.h>
+#include <unistd.h>
+#ifdef __linux__
+#include <sys/ioctl.h>
+#include <sys/syscall.h>
+#include <linux/perf_event.h>
+#endif
+
+#include "filters.h"
+#include "pixops.h"
+#ifdef HAVE_NEON32
+#include "arm/neon_scale2x.h"
+#include "arm/neon_eagle2x.h"
+#endif
+#ifdef BENCH_PNG
+#include "readpng.h"
+#endif
+
+#define MAX_RES 8
+#define MAX_FILES 16
+
+static const struct {
+	const char *name;
+	int filter;
+	int scale;
+} filters[] = {
+	{ "normal1x", FILTER_NORMAL1X, 1 },
+	{ "normal2x", FILTER_NORMAL2X, 2 },
+	{ "scale2x",  FILTER_SCALE2X,  2 },
+	{ "eagle2x",  FILTER_EAGLE2X,  2 },
+	{ "scale3x",  FILTER_SCALE3X,  3 },
+	{ "eagle3x",  FILTER_EAGLE3X,  3 },
+	{ "scale4x",  FILTER_SCALE4X,  4 },
+	{ "eagle4x",  FILTER_EAGLE4X,  4 },
+	{ "hq2x",     FILTER_HQ2X,     2 },
+	{ "hq3x",     FILTER_HQ3X,     3 },
+};
+
+static const struct {
+	const char *name;
+	int format;
+	int src_bpp, dst_bpp;
+} formats[] = {
+	{ "8_8",   FILTER_FMT_8_8,   1, 1 },
+	{ "16_16", FILTER_FMT_16_16, 2, 2 },
+	{ "8_16",  FILTER_FMT_8_16,  1, 2 },
+	{ "8_32",  FILTER_FMT_8_32,  1, 4 },
+	{ "16_32", FILTER_FMT_16_32, 2, 4 },
+};
+
+#define ARRAY_SIZE(x) (sizeof(x) / sizeof(x[0]))
+
+/* frame set being measured */
+static struct {
+	const char *name;
+	int w, h;
+	uint16_t *src16;
+	uint8_t *src8;
+} frame;
+
+static uint32_t pal16[256], pal32[256];
+static void *dst;
+
+static double opt_time = 0.2;
+static int opt_json;
+static int opt_threads;
+static int opt_check;
+static const char *opt_kernel;
+
+/* results go here, stdout is pointed at stderr for everything else */
+static FILE *out;
+static int results;
+
+#ifdef BENCH_PNG
+/* readpng.c wants this from the host program */
+void lprintf(const char *fmt, ...)
+{
+	va_list ap;
+
+	va_start(ap, fmt);
+	vfprintf(stderr, fmt, ap);
+	va_end(ap);
+}
+#endif
+
+static double get_time(void)
+{
+	struct timespec ts;
+
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+/* perf counters, fd -1 if not available */
+#ifdef __linux__
+static int perf_open(unsigned int type, unsigned long long config)
+{
+	struct perf_event_attr attr;
+
+	memset(&attr, 0, sizeof(attr));
+	attr.size = sizeof(attr);
+	attr.type = type;
+	attr.config = config;
+	attr.disabled = 1;
+	attr.exclude_kernel = 1;
+	attr.exclude_hv = 1;
+	attr.inherit = 1;	/* filter threads */
+
+	return syscall(__NR_perf_event_open, &attr, 0, -1, -1, 0);
+}
+
+static void perf_start(int fd)
+{
+	if (fd < 0)
+		return;
+	ioctl(fd, PERF_EVENT_IOC_RESET, 0);
+	ioctl(fd, PERF_EVENT_IOC_ENABLE, 0);
+}
+
+static long long perf_stop(int fd)
+{
+	long long v = -1;
+
+	if (fd < 0)
+		return -1;
+	ioctl(fd, PERF_EVENT_IOC_DISABLE, 0);
+	if (read(fd, &v, sizeof(v)) != sizeof(v))
+		return -1;
+	return v;
+}
+#else
+#define perf_open(type, config) -1
+#define perf_start(fd)
+#define perf_stop(fd) -1LL
+#endif
+
+static int perf_cycles = -1, perf_misses = -1;
+
+static void report(const char *kernel, const char *impl, int frames,
+	double t, long long cycles, long long misses)
+{
+	double pixels = (double)frame.w * frame.h * frames;
+	double mpix = pixels / t / 1000000.0;
+	char cpp[32] = "", cmf[32] = "";
+
+	if (cycles >= 0)
+		snprintf(cpp, sizeof(cpp), "%.2f", cycles / pixels);
+	if (misses >= 0)
+		snprintf(cmf, sizeof(cmf), "%.0f", (double)misses / frames);
+
+	if (opt_json) {
+		fprintf(out, "%s\n  {\"kernel\": \"%s\", \"impl\": \"%s\", "
+			"\"frame_set\": \"%s\", \"width\": %d, \"height\": %d, "
+			"\"threads\": %d, \"count\": %d, \"mpix_s\": %.2f, "
+			"\"cycles_px\": %s, \"cache_misses_frame\": %s}",
+			results ? "," : "", kernel, impl, frame.name,
+			frame.w, frame.h, opt_threads, frames, mpix,
+			cpp[0] ? cpp : "null", cmf[0] ? cmf : "null");
+	}
+	else {
+		fprintf(out, "%s,%s,%s,%d,%d,%d,%d,%.2f,%s,%s\n", kernel, impl,
+			frame.name, frame.w, frame.h, opt_threads, frames, mpix,
+			cpp, cmf);
+	}
+	fflush(out);
+	results++;
+}
+
+static void run_job(const struct filter_job *job)
+{
+	if (opt_threads > 0) {
+		filter_threads_start(job);
+		filter_threads_wait();
+	}
+	else
+		filter_job_lines(job, 0, job->height);
+}
+
+static void bench_job(const char *kernel, int impl, struct filter_job *job)
+{
+	double t0, t;
+	long long cycles, misses;
+	int frames = 0;
+
+	filters_set_impl(impl);
+	run_job(job);	/* warm up */
+
+	perf_start(perf_cycles);
+	perf_start(perf_misses);
+	t0 = get_time();
+	do {
+		run_job(job);
+		frames++;
+		t = get_time() - t0;
+	} while (t < opt_time);
+	cycles = perf_stop(perf_cycles);
+	misses = perf_stop(perf_misses);
+
+	report(kernel, filters_impl_name(impl), frames, t, cycles, misses);
+}
+
+static int combo_ok(int filter, int scale, int format)
+{
+	if (scale == 4 && (format == FILTER_FMT_8_32 || format == FILTER_FMT_16_32))
+		return 0;
+	if ((filter == FILTER_HQ2X || filter == FILTER_HQ3X)
+	    && (format == FILTER_FMT_8_8 || format == FILTER_FMT_8_32))
+		return 0;
+	return 1;
+}
+
+static void bench_frame(void)
+{
+	struct filter_job job;
+	char kernel[32];
+	unsigned int f, m;
+	int impl;
+
+	for (f = 0; f < ARRAY_SIZE(filters); f++) {
+		for (m = 0; m < ARRAY_SIZE(formats); m++) {
+			if (!combo_ok(filters[f].filter, filters[f].scale, formats[m].format))
+				continue;
+			snprintf(kernel, sizeof(kernel), "%s_%s",
+				filters[f].name, formats[m].name);
+			if (opt_kernel != NULL && strstr(kernel, opt_kernel) == NULL)
+				continue;
+
+			memset(&job, 0, sizeof(job));
+			job.filter = filters[f].filter;
+			job.format = formats[m].format;
+			job.src = formats[m].src_bpp == 1 ? (void *)frame.src8 : (void *)frame.src16;
+			job.dst = dst;
+			job.palette = formats[m].dst_bpp == 4 ? pal32 : pal16;
+			job.width = frame.w;
+			job.srcstride = frame.w * formats[m].src_bpp;
+			job.dststride = frame.w * filters[f].scale * formats[m].dst_bpp;
+			job.height = frame.h;
+
+			for (impl = 0; impl < FILTER_IMPL_COUNT; impl++)
+				if (filters_set_impl(impl) == impl)
+					bench_job(kernel, impl, &job);
+		}
+	}
+
+#ifdef HAVE_NEON32
+	{
+		static const struct {
+			const char *name;
+			void (*f8)(const uint8_t *, uint8_t *, unsigned int,
+				unsigned int, unsigned int, unsigned int);
+			void (*f16)(const uint16_t *, uint16_t *, unsigned int,
+				unsigned int, unsigned int, unsigned int);
+			void (*fpal)(const uint8_t *, uint16_t *, const uint32_t *,
+				unsigned int, unsigned int, unsigned int, unsigned int);
+		} asm_funcs[] = {
+			{ "scale2x", neon_scale2x_8_8, neon_scale2x_16_16, neon_scale2x_8_16 },
+			{ "eagle2x", neon_eagle2x_8_8, neon_eagle2x_16_16, neon_eagle2x_8_16 },
+		};
+		double t0, t;
+		long long cycles, misses;
+		int frames;
+
+		for (f = 0; f < ARRAY_SIZE(asm_funcs); f++) {
+			for (m = 0; m < 3; m++) {
+				snprintf(kernel, sizeof(kernel), "%s_%s",
+					asm_funcs[f].name, formats[m].name);
+				if (opt_kernel != NULL && strstr(kernel, opt_kernel) == NULL)
+					continue;
+
+				frames = 0;
+				perf_start(perf_cycles);
+				perf_start(perf_misses);
+				t0 = get_time();
+				do {
+					if (m == 0)
+						asm_funcs[f].f8(frame.src8, dst, frame.w,
+							frame.w, frame.w * 2, frame.h);
+					else if (m == 1)
+						asm_funcs[f].f16(frame.src16, dst, frame.w,
+							frame.w * 2, frame.w * 4, frame.h);
+					else
+						asm_funcs[f].fpal(frame.src8, dst, pal16,
+							frame.w, frame.w, frame.w * 4, frame.h);
+					frames++;
+					t = get_time() - t0;
+				} while (t < opt_time);
+				cycles = perf_stop(perf_cycles);
+				misses = perf_stop(perf_misses);
+
+				report(kernel, "asm", frames, t, cycles, misses);
+			}
+		}
+	}
+#endif
+}
+
+/* 8bpp version of the frame is RGB332 indexes into the palettes */
+static void make_src8(void)
+{
+	int i;
+
+	for (i = 0; i < frame.w * frame.h; i++) {
+		uint16_t c = frame.src16[i];
+		frame.src8[i] = (c >> 8 & 0xe0) | (c >> 6 & 0x1c) | (c >> 3 & 3);
+	}
+}
+
+static void make_palettes(void)
+{
+	int i, r, g, b;
+
+	for (i = 0; i < 256; i++) {
+		r = (i >> 5) * 255 / 7;
+		g = ((i >> 2) & 7) * 255 / 7;
+		b = (i & 3) * 255 / 3;
+		pal16[i] = ((r & 0xf8) << 8) | ((g & 0xfc) << 3) | (b >> 3);
+		pal32[i] = (r << 16) | (g << 8) | b;
+	}
+}
+
+static uint16_t rnd565(unsigned int *seed, int colors)
+{
+	static const uint16_t cols[] = {
+		0x0000, 0xffff, 0xf800, 0x07e0, 0x001f, 0x8410, 0xfd20, 0x4208,
+	};
+
+	*seed = *seed * 1103515245 + 12345;
+	return cols[(*seed >> 16) % colors];
+}
+
+/* synthetic frames */
+static void gen_frame(const char *name)
+{
+	unsigned int seed = 1;
+	uint16_t tile[8][8][8];
+	int x, y, t;
+
+	frame.name = name;
+	if (strcmp(name, "flat") == 0) {
+		for (x = 0; x < frame.w * frame.h; x++)
+			frame.src16[x] = 0x39e7;
+	}
+	else if (strcmp(name, "noise") == 0) {
+		/* worst case for anything that skips equal pixels */
+		for (x = 0; x < frame.w * frame.h; x++)
+			frame.src16[x] = rnd565(&seed, 4);
+	}
+	else {
+		/* "tiles", 8x8 tiles of few colors like typical 2D backgrounds */
+		for (t = 0; t < 8; t++)
+			for (y = 0; y < 8; y++)
+				for (x = 0; x < 8; x++)
+					tile[t][y][x] = rnd565(&seed, (t & 3) + 2);
+		for (y = 0; y < frame.h; y++) {
+			for (x = 0; x < frame.w; x++) {
+				t = ((x / 8) * 7 + (y / 8) * 3) & 7;
+				frame.src16[y * frame.w + x] = tile[t][y & 7][x & 7];
+			}
+		}
+	}
+	make_src8();
+}
+
+/*
+ * conformance check: every implementation against naive per-pixel
+ * references, on small frames of odd sizes with padded strides and
+ * misaligned buffers. Anything written outside the output area is an
+ * error too. Under qemu-user it checks the ARM code on x86 hosts.
+ */
+
+/* value the filters compare: palette index, or color for 8_16
+ * (which, like the asm, applies the palette first) */
+static uint32_t ref_fetch(const struct filter_job *j, int x, int y)
+{
+	const uint8_t *p;
+
+	x = x < 0 ? 0 : (x >= (int)j->width ? (int)j->width - 1 : x);
+	y = y < 0 ? 0 : (y >= (int)j->height ? (int)j->height - 1 : y);
+	p = (const uint8_t *)j->src + y * j->srcstride;
+
+	switch (j->format) {
+	case FILTER_FMT_16_16:
+	case FILTER_FMT_16_32:
+		return ((const uint16_t *)p)[x];
+	case FILTER_FMT_8_16:
+		return (uint16_t)j->palette[p[x]];
+	case FILTER_FMT_8_32:
+		/* colours, not indexes, must decide the edges */
+		return j->palette[p[x]];
+	default:
+		return p[x];
+	}
+}
+
+static uint32_t ref_output(const struct filter_job *j, uint32_t v)
+{
+	uint32_t r, g, b;
+
+	switch (j->format) {
+	case FILTER_FMT_16_32:
+		r = v >> 11; g = (v >> 5) & 0x3f; b = v & 0x1f;
+		return (r << 19 | (r >> 2) << 16) | (g << 10 | (g >> 4) << 8)
+			| (b << 3 | b >> 2);
+	default:
+		return v;
+	}
+}
+
+/* n[] is the 3x3 neighbourhood, o[] gets scale x scale pixels */
+static void ref_pixel(int filter, const uint32_t *n, uint32_t *o)
+{
+	uint32_t A = n[0], B = n[1], C = n[2], D = n[3], E = n[4];
+	uint32_t F = n[5], G = n[6], H = n[7], I = n[8];
+	int tl, tr, bl, br, i;
+
+	switch (filter) {
+	case FILTER_NORMAL1X:
+		o[0] = E;
+		break;
+	case FILTER_NORMAL2X:
+		o[0] = o[1] = o[2] = o[3] = E;
+		break;
+	case FILTER_SCALE2X:
+		o[0] = (D == B && B != H && D != F) ? D : E;
+		o[1] = (B == F && B != H && D != F) ? F : E;
+		o[2] = (D == H && B != H && D != F) ? D : E;
+		o[3] = (H == F && B != H && D != F) ? F : E;
+		break;
+	case FILTER_EAGLE2X:
+		o[0] = (A == B && A == D) ? B : E;
+		o[1] = (C == B && C == F) ? B : E;
+		o[2] = (G == H && G == D) ? H : E;
+		o[3] = (I == H && I == F) ? H : E;
+		break;
+	case FILTER_SCALE3X:
+		for (i = 0; i < 9; i++)
+			o[i] = E;
+		if (B == H || D == F)
+			break;
+		if (D == B) o[0] = D;
+		if ((D == B && E != C) || (B == F && E != A)) o[1] = B;
+		if (B == F) o[2] = F;
+		if ((D == B && E != G) || (D == H && E != A)) o[3] = D;
+		if ((B == F && E != I) || (H == F && E != C)) o[5] = F;
+		if (D == H) o[6] = D;
+		if ((D == H && E != I) || (H == F && E != G)) o[7] = H;
+		if (H == F) o[8] = F;
+		break;
+	case FILTER_EAGLE3X:
+		tl = A == B && A == D; tr = C == B && C == F;
+		bl = G == H && G == D; br = I == H && I == F;
+		o[0] = tl ? B : E;
+		o[1] = tl && tr ? B : E;
+		o[2] = tr ? B : E;
+		o[3] = tl && bl ? D : E;
+		o[4] = E;
+		o[5] = tr && br ? F : E;
+		o[6] = bl ? H : E;
+		o[7] = bl && br ? H : E;
+		o[8] = br ? H : E;
+		break;
+	}
+}
+
+/* filter a w x h image of compare values, 4x as 2x twice */
+static uint32_t *ref_image(int filter, const uint32_t *in, int w, int h,
+	int *scale_out)
+{
+	int scale, x, y, i, k;
+	uint32_t n[9], o[16], *out, *mid;
+
+	if (filter == FILTER_SCALE4X || filter == FILTER_EAGLE4X) {
+		filter = filter == FILTER_SCALE4X ? FILTER_SCALE2X : FILTER_EAGLE2X;
+		mid = ref_image(filter, in, w, h, &scale);
+		out = ref_image(filter, mid, w * 2, h * 2, &scale);
+		free(mid);
+		*scale_out = 4;
+		return out;
+	}
+
+	scale = filter == FILTER_NORMAL1X ? 1
+		: (filter == FILTER_SCALE3X || filter == FILTER_EAGLE3X) ? 3 : 2;
+	out = malloc(w * h * scale * scale * sizeof(out[0]));
+	for (y = 0; y < h; y++) {
+		for (x = 0; x < w; x++) {
+			for (i = 0; i < 9; i++) {
+				int nx = x + i % 3 - 1, ny = y + i / 3 - 1;
+				nx = nx < 0 ? 0 : (nx >= w ? w - 1 : nx);
+				ny = ny < 0 ? 0 : (ny >= h ? h - 1 : ny);
+				n[i] = in[ny * w + nx];
+			}
+			ref_pixel(filter, n, o);
+			for (i = 0; i < scale; i++)
+				for (k = 0; k < scale; k++)
+					out[(y * scale + i) * w * scale + x * scale + k] =
+						o[i * scale + k];
+		}
+	}
+	*scale_out = scale;
+	return out;
+}
+
+#define GUARD 64
+
+static int check_fails, check_count;
+
+/* dst must point GUARD bytes into a buffer filled with 0xa5 */
+static void check_result(const char *kernel, const char *impl,
+	const struct filter_job *j, const uint8_t *dst_buf, size_t dst_size,
+	int bpp)
+{
+	uint32_t *in, *ref, v;
+	const uint8_t *d = (const uint8_t *)j->dst;
+	int scale, x, y, w = j->width, h = j->height;
+	int bad = 0;
+	size_t i, row_bytes;
+
+	check_count++;
+	in = malloc(w * h * sizeof(in[0]));
+	for (y = 0; y < h; y++)
+		for (x = 0; x < w; x++)
+			in[y * w + x] = ref_fetch(j, x, y);
+	ref = ref_image(j->filter, in, w, h, &scale);
+
+	row_bytes = w * scale * bpp;
+	for (y = 0; y < h * scale && !bad; y++) {
+		for (x = 0; x < w * scale; x++) {
+			const uint8_t *p = d + y * j->dststride + x * bpp;
+			v = bpp == 1 ? p[0] : bpp == 2 ? *(const uint16_t *)p : *(const uint32_t *)p;
+			if (v != ref_output(j, ref[y * w * scale + x])) {
+				fprintf(stderr, "%s %s %ux%u strides %u/%u: "
+					"mismatch at %d,%d: %x, expected %x\n",
+					kernel, impl, j->width, j->height,
+					j->srcstride, j->dststride, x, y, v,
+					ref_output(j, ref[y * w * scale + x]));
+				bad = 1;
+				break;
+			}
+		}
+	}
+
+	/* everything outside of the output lines must be untouched */
+	for (i = 0; i < dst_size && !bad; i++) {
+		size_t o = (size_t)(dst_buf + i - d);
+		if (dst_buf + i >= d && o / j->dststride < (size_t)h * scale
+		    && o % j->dststride < row_bytes)
+			continue;
+		if (dst_buf[i] != 0xa5) {
+			fprintf(stderr, "%s %s %ux%u strides %u/%u: "
+				"write outside of output at %d\n",
+				kernel, impl, j->width, j->height,
+				j->srcstride, j->dststride, (int)(dst_buf + i - d));
+			bad = 1;
+		}
+	}
+
+	check_fails += bad;
+	free(in);
+	free(ref);
+}
+
+static void check_case(unsigned int f, unsigned int m, int w, int height,
+	int pad, const uint8_t *src_buf, const uint32_t *pal)
+{
+	int scale = filters[f].scale;
+	int sbpp = formats[m].src_bpp, dbpp = formats[m].dst_bpp;
+	struct filter_job job;
+	uint8_t *dst_buf;
+	size_t dst_size;
+	int impl;
+
+	memset(&job, 0, sizeof(job));
+	job.filter = filters[f].filter;
+	job.format = formats[m].format;
+	job.palette = pal;
+	job.width = w;
+	job.height = height;
+	job.srcstride = (w + pad) * sbpp;
+	job.dststride = (w * scale + pad) * dbpp;
+	/* misaligned by a pixel, for 16 byte vectors */
+	job.src = src_buf + sbpp;
+
+	dst_size = job.dststride * job.height * scale + GUARD * 2;
+	dst_buf = malloc(dst_size);
+
+	for (impl = 0; impl < FILTER_IMPL_COUNT; impl++) {
+		char kernel[32];
+
+		if (filters_set_impl(impl) != impl)
+			continue;
+		memset(dst_buf, 0xa5, dst_size);
+		job.dst = dst_buf + GUARD + dbpp;
+		filter_job_lines(&job, 0, job.height);
+		snprintf(kernel, sizeof(kernel), "%s_%s",
+			filters[f].name, formats[m].name);
+		check_result(kernel, filters_impl_name(impl), &job,
+			dst_buf, dst_size, dbpp);
+	}
+
+#ifdef HAVE_NEON32
+	/* the asm wants at least one middle line and a 16 byte block */
+	if (job.height >= 3 && w * sbpp >= 16 && m < 3
+	    && (job.filter == FILTER_SCALE2X || job.filter == FILTER_EAGLE2X)) {
+		int sc = job.filter == FILTER_SCALE2X;
+
+		memset(dst_buf, 0xa5, dst_size);
+		job.dst = dst_buf + GUARD + dbpp;
+		if (m == 0)
+			(sc ? neon_scale2x_8_8 : neon_eagle2x_8_8)(job.src,
+				job.dst, w, job.srcstride, job.dststride, job.height);
+		else if (m == 1)
+			(sc ? neon_scale2x_16_16 : neon_eagle2x_16_16)(job.src,
+				job.dst, w, job.srcstride, job.dststride, job.height);
+		else
+			(sc ? neon_scale2x_8_16 : neon_eagle2x_8_16)(job.src,
+				job.dst, pal, w, job.srcstride, job.dststride,
+				job.height);
+		check_result(sc ? "neon_scale2x" : "neon_eagle2x", "asm",
+			&job, dst_buf, dst_size, dbpp);
+	}
+#endif
+	free(dst_buf);
+}
+
+static int check_all(void)
+{
+	static const int heights[] = { 1, 2, 3, 4, 7 };
+	static const int pads[] = { 0, 1, 3 };	/* stride padding, pixels */
+	unsigned int seed = 1, f, m, hi, pi;
+	uint32_t pal[256], pal_dup[256];
+	uint8_t *src_buf;
+	int w, i;
+
+	for (i = 0; i < 256; i++) {
+		seed = seed * 1103515245 + 12345;
+		pal[i] = seed ^ (seed >> 16);
+	}
+	/* same colour under two of the used indexes */
+	memcpy(pal_dup, pal, sizeof(pal_dup));
+	pal_dup[2] = pal_dup[0];
+	/* pixel values come from a few colors, so that they match often */
+	src_buf = malloc((70 + 3) * 7 * 2 + 16);
+	for (i = 0; i < (70 + 3) * 7 * 2 + 16; i++) {
+		seed = seed * 1103515245 + 12345;
+		src_buf[i] = (seed >> 16) % 3;
+	}
+
+	for (f = 0; f < ARRAY_SIZE(filters); f++) {
+		if (filters[f].filter == FILTER_HQ2X || filters[f].filter == FILTER_HQ3X)
+			continue;	/* C only, no reference */
+		for (m = 0; m < ARRAY_SIZE(formats); m++) {
+			if (!combo_ok(filters[f].filter, filters[f].scale, formats[m].format))
+				continue;
+			for (w = 1; w <= 70; w++)
+				for (hi = 0; hi < ARRAY_SIZE(heights); hi++)
+					for (pi = 0; pi < ARRAY_SIZE(pads); pi++) {
+						check_case(f, m, w, heights[hi],
+							pads[pi], src_buf, pal);
+						if (formats[m].format == FILTER_FMT_8_16
+						    || formats[m].format == FILTER_FMT_8_32)
+							check_case(f, m, w, heights[hi],
+								pads[pi], src_buf, pal_dup);
+					}
+		}
+	}
+
+	free(src_buf);
+	fprintf(out, "%d checks, %d failed\n", check_count, check_fails);
+	return check_fails;
+}
+
+static void usage(const char *argv0)
+{
+	printf("usage: %s [options]\n"
+		"  -r WxH    frame size, can be repeated (256x224 320x240 640x480)\n"
+		"  -i file   also use a .png frame, can be repeated\n"
+		"  -k name   only kernels with name in them, like scale2x_8_16\n"
+		"  -t sec    time per kernel (%.1f)\n"
+		"  -j n      use the threaded driver with n threads (0: all CPUs)\n"
+		"  -json     JSON output instead of CSV\n"
+		"  -check    check all kernels against reference code instead\n",
+		argv0, opt_time);
+}
+
+int main(int argc, char *argv[])
+{
+	static const char *synth[] = { "flat", "tiles", "noise" };
+	int res_w[MAX_RES], res_h[MAX_RES], res_count = 0;
+#ifdef BENCH_PNG
+	const char *files[MAX_FILES];
+	int file_count = 0;
+#endif
+	unsigned int i;
+	int r;
+
+	/* keep the CSV/JSON clean of anything libraries print */
+	out = fdopen(dup(STDOUT_FILENO), "w");
+	if (out == NULL || dup2(STDERR_FILENO, STDOUT_FILENO) == -1) {
+		perror("stdout");
+		return 1;
+	}
+
+	for (r = 1; r < argc; r++) {
+		if (strcmp(argv[r], "-r") == 0 && r + 1 < argc && res_count < MAX_RES) {
+			if (sscanf(argv[++r], "%dx%d", &res_w[res_count], &res_h[res_count]) == 2
+			    && res_w[res_count] > 0 && res_h[res_count] > 0)
+				res_count++;
+		}
+		else if (strcmp(argv[r], "-i") == 0 && r + 1 < argc) {
+#ifdef BENCH_PNG
+			if (file_count < MAX_FILES)
+				files[file_count++] = argv[r + 1];
+#else
+			fprintf(stderr, "built without BENCH_PNG, -i ignored\n");
+#endif
+			r++;
+		}
+		else if (strcmp(argv[r], "-k") == 0 && r + 1 < argc)
+			opt_kernel = argv[++r];
+		else if (strcmp(argv[r], "-t") == 0 && r + 1 < argc)
+			opt_time = atof(argv[++r]);
+		else if (strcmp(argv[r], "-j") == 0 && r + 1 < argc)
+			opt_threads = filter_threads_init(atoi(argv[++r]));
+		else if (strcmp(argv[r], "-json") == 0)
+			opt_json = 1;
+		else if (strcmp(argv[r], "-check") == 0)
+			opt_check = 1;
+		else {
+			usage(argv[0]);
+			return 1;
+		}
+	}
+
+	if (res_count == 0) {
+		res_w[0] = 256; res_h[0] = 224;
+		res_w[1] = 320; res_h[1] = 240;
+		res_w[2] = 640; res_h[2] = 480;
+		res_count = 3;
+	}
+	pixops_init();
+	if (opt_check)
+		return check_all() ? 1 : 0;
+
+	perf_cycles = perf_open(PERF_TYPE_HARDWARE, PERF_COUNT_HW_CPU_CYCLES);
+	perf_misses = perf_open(PERF_TYPE_HARDWARE, PERF_COUNT_HW_CACHE_MISSES);
+	if (perf_cycles < 0)
+		fprintf(stderr, "perf counters not available\n");
+
+	make_palettes();
+
+	if (opt_json)
+		fprintf(out, "[");
+	else
+		fprintf(out, "kernel,impl,frame_set,width,height,threads,count,"
+			"mpix_s,cycles_px,cache_misses_frame\n");
+
+	for (r = 0; r < res_count; r++) {
+		frame.w = res_w[r];
+		frame.h = res_h[r];
+		frame.src16 = calloc(frame.w * frame.h, 2);
+		frame.src8 = malloc(frame.w * frame.h);
+		/* worst case: 4x at 16bpp, 3x at 32bpp */
+		dst = malloc(frame.w * frame.h * 36);
+		if (frame.src16 == NULL || frame.src8 == NULL || dst == NULL) {
+			fprintf(stderr, "OOM\n");
+			return 1;
+		}
+
+		for (i = 0; i < ARRAY_SIZE(synth); i++) {
+			gen_frame(synth[i]);
+			bench_frame();
+		}
+#ifdef BENCH_PNG
+		for (i = 0; i < (unsigned int)file_count; i++) {
+			memset(frame.src16, 0, frame.w * frame.h * 2);
+			if (readpng(frame.src16, files[i], READPNG_BG, frame.w, frame.h) != 0)
+				continue;
+			frame.name = strrchr(files[i], '/') ? strrchr(files[i], '/') + 1 : files[i];
+			make_src8();
+			bench_frame();
+		}
+#endif
+		free(frame.src16);
+		free(frame.src8);
+		free(dst);
+	}
+
+	if (opt_json)
+		fprintf(out, "\n]\n");
+
+	filter_threads_finish();
+	return 0;
+}
@@ -0,0 +1,172 @@
+/* internal to filter implementations */
+#ifndef LIBPICOFE_FILTERS_INT_H
+#define LIBPICOFE_FILTERS_INT_H
+
+#include <inttypes.h>
+
+#if defined(HAVE_NEON32) || defined(__ARM_NEON__) || defined(__ARM_NEON)
+#define FILTERS_NEON 1
+#endif
+
+/*
+ * line kernels: produce 2 or 3 output lines, starting at d and dststride
+ * bytes apart, from 3 source lines, b(efore), e (current) and h (next,
+ * named as in scale2x docs). Frame edges are handled by the caller
+ * passing e for b/h.
+ */
+typedef void (filter_line_8)(uint8_t *d, unsigned int dststride,
+	const uint8_t *b, const uint8_t *e, const uint8_t *h, unsigned int w);
+typedef void (filter_line_16)(uint16_t *d, unsigned int dststride,
+	const uint16_t *b, const uint16_t *e, const uint16_t *h, unsigned int w);
+
+struct filter_lines {
+	filter_line_8  *scale2x_8;
+	filter_line_16 *scale2x_16;
+	filter_line_8  *eagle2x_8;
+	filter_line_16 *eagle2x_16;
+	filter_line_8  *scale3x_8;
+	filter_line_16 *scale3x_16;
+	filter_line_8  *eagle3x_8;
+	filter_line_16 *eagle3x_16;
+};
+
+extern const struct filter_lines filter_lines_c;
+#if defined(__i386__) || defined(__x86_64__)
+extern const struct filter_lines filter_lines_sse2;
+extern const struct filter_lines filter_lines_avx2;
+#endif
+#ifdef FILTERS_NEON
+extern const struct filter_lines filter_lines_neon;
+#endif
+
+/* for filter worker threads to call before exiting */
+void filter_scratch_free(void);
+
+#define FILTER_LINE(d, n, stride) \
+	((void *)((char *)(d) + (n) * (stride)))
+
+/*
+ * scalar versions working on [x, x_end) of a w pixel line,
+ * also used by SIMD code for the line edges.
+ */
+#define FILTER_SCALE2X_C(name, type) \
+static inline void name(type *d, unsigned int ds, const type *b, \
+	const type *e, const type *h, unsigned int x, unsigned int x_end, \
+	unsigned int w) \
+{ \
+	type *d1 = FILTER_LINE(d, 1, ds); \
+\
+	for (; x < x_end; x++) { \
+		type B = b[x], E = e[x], H = h[x]; \
+		type D = e[x > 0 ? x - 1 : x]; \
+		type F = e[x + 1 < w ? x + 1 : x]; \
+		type *o0 = d + x * 2, *o1 = d1 + x * 2; \
+		o0[0] = o0[1] = o1[0] = o1[1] = E; \
+		if (B != H && D != F) { \
+			if (D == B) o0[0] = D; \
+			if (B == F) o0[1] = F; \
+			if (D == H) o1[0] = D; \
+			if (H == F) o1[1] = F; \
+		} \
+	} \
+}
+
+/* S T U  --\ E1 E2
+ * V C W  --/ E3 E4
+ * X Y Z */
+#define FILTER_EAGLE2X_C(name, type) \
+static inline void name(type *d, unsigned int ds, const type *b, \
+	const type *e, const type *h, unsigned int x, unsigned int x_end, \
+	unsigned int w) \
+{ \
+	type *d1 = FILTER_LINE(d, 1, ds); \
+\
+	for (; x < x_end; x++) { \
+		unsigned int l = x > 0 ? x - 1 : x; \
+		unsigned int r = x + 1 < w ? x + 1 : x; \
+		type S = b[l], T = b[x], U = b[r]; \
+		type V = e[l], C = e[x], W = e[r]; \
+		type X = h[l], Y = h[x], Z = h[r]; \
+		d[x * 2]      = (S == T && S == V) ? T : C; \
+		d[x * 2 + 1]  = (U == T && U == W) ? T : C; \
+		d1[x * 2]     = (X == Y && X == V) ? Y : C; \
+		d1[x * 2 + 1] = (Z == Y && Z == W) ? Y : C; \
+	} \
+}
+
+/* A B C      E0 E1 E2
+ * D E F  --> E3 E4 E5
+ * G H I      E6 E7 E8 */
+#define FILTER_SCALE3X_C(name, type) \
+static inline void name(type *d, unsigned int ds, const type *b, \
+	const type *e, const type *h, unsigned int x, unsigned int x_end, \
+	unsigned int w) \
+{ \
+	type *d1 = FILTER_LINE(d, 1, ds); \
+	type *d2 = FILTER_LINE(d, 2, ds); \
+\
+	for (; x < x_end; x++) { \
+		unsigned int l = x > 0 ? x - 1 : x; \
+		unsigned int r = x + 1 < w ? x + 1 : x; \
+		type A = b[l], B = b[x], C = b[r]; \
+		type D = e[l], E = e[x], F = e[r]; \
+		type G = h[l], H = h[x], I = h[r]; \
+		type *o0 = d + x * 3, *o1 = d1 + x * 3, *o2 = d2 + x * 3; \
+		o0[0] = o0[1] = o0[2] = o1[0] = o1[1] = o1[2] = \
+		o2[0] = o2[1] = o2[2] = E; \
+		if (B != H && D != F) { \
+			if (D == B) o0[0] = D; \
+			if ((D == B && E != C) || (B == F && E != A)) o0[1] = B; \
+			if (B == F) o0[2] = F; \
+			if ((D == B && E != G) || (D == H && E != A)) o1[0] = D; \
+			if ((B == F && E != I) || (H == F && E != C)) o1[2] = F; \
+			if (D == H) o2[0] = D; \
+			if ((D == H && E != I) || (H == F && E != G)) o2[1] = H; \
+			if (H == F) o2[2] = F; \
+		} \
+	} \
+}
+
+/* eagle2x corners, edge pixels only follow when both their corners do:
+ * S T U      E0 E1 E2
+ * V C W  --> E3 C  E5
+ * X Y Z      E6 E7 E8 */
+#define FILTER_EAGLE3X_C(name, type) \
+static inline void name(type *d, unsigned int ds, const type *b, \
+	const type *e, const type *h, unsigned int x, unsigned int x_end, \
+	unsigned int w) \
+{ \
+	type *d1 = FILTER_LINE(d, 1, ds); \
+	type *d2 = FILTER_LINE(d, 2, ds); \
+\
+	for (; x < x_end; x++) { \
+		unsigned int l = x > 0 ? x - 1 : x; \
+		unsigned int r = x + 1 < w ? x + 1 : x; \
+		type S = b[l], T = b[x], U = b[r]; \
+		type V = e[l], C = e[x], W = e[r]; \
+		type X = h[l], Y = h[x], Z = h[r]; \
+		int tl = S == T && S == V, tr = U == T && U == W; \
+		int bl = X == Y && X == V, br = Z == Y && Z == W; \
+		type *o0 = d + x * 3, *o1 = d1 + x * 3, *o2 = d2 + x * 3; \
+		o0[0] = tl ? T : C; \
+		o0[1] = tl && tr ? T : C; \
+		o0[2] = tr ? T : C; \
+		o1[0] = tl && bl ? V : C; \
+		o1[1] = C; \
+		o1[2] = tr && br ? W : C; \
+		o2[0] = bl ? Y : C; \
+		o2[1] = bl && br ? Y : C; \
+		o2[2] = br ? Y : C; \
+	} \
+}
+
+FILTER_SCALE2X_C(scale2x_line8_c, uint8_t)
+FILTER_SCALE2X_C(scale2x_line16_c, uint16_t)
+FILTER_EAGLE2X_C(eagle2x_line8_c, uint8_t)
+FILTER_EAGLE2X_C(eagle2x_line16_c, uint16_t)
+FILTER_SCALE3X_C(scale3x_line8_c, uint8_t)
+FILTER_SCALE3X_C(scale3x_line16_c, uint16_t)
+FILTER_EAGLE3X_C(eagle3x_line8_c, uint8_t)
+FILTER_EAGLE3X_C(eagle3x_line16_c, uint16_t)
+
+#endif /* LIBPICOFE_FILTERS_INT_H */
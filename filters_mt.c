@@ -0,0 +1,156 @@
+/*
+ * threaded filter driver, persistent worker pool
+ *
+ * This work is licensed under the terms of any of these licenses
+ * (at your option):
+ *  - GNU GPL, version 2 or later.
+ *  - GNU LGPL, version 2.1 or later.
+ *  - MAME license.
+ * See the COPYING file in the top-level directory.
+ */
+
+#define _GNU_SOURCE 1
+#include <stdio.h>
+#include <string.h>
+#include <pthread.h>
+#include <sched.h>
+#include <unistd.h>
+
+#include "filters.h"
+#include "filters_int.h"
+
+#define MAX_THREADS 16
+
+static pthread_t threads[MAX_THREADS];
+static int thread_count;
+
+static pthread_mutex_t mt_mutex = PTHREAD_MUTEX_INITIALIZER;
+static pthread_cond_t mt_cond_start = PTHREAD_COND_INITIALIZER;
+static pthread_cond_t mt_cond_done = PTHREAD_COND_INITIALIZER;
+static struct filter_job mt_job;
+static unsigned int mt_frame;	/* bumped for each new job */
+static int mt_pending;		/* bands not done yet */
+static int mt_exit;
+
+static void *filter_thread(void *arg)
+{
+	int index = (long)arg;
+	unsigned int frame_done = 0;
+	struct filter_job job;
+	unsigned int y, y_end;
+
+#ifdef __linux__
+	cpu_set_t set;
+
+	CPU_ZERO(&set);
+	CPU_SET(index % sysconf(_SC_NPROCESSORS_ONLN), &set);
+	if (pthread_setaffinity_np(pthread_self(), sizeof(set), &set) != 0)
+		fprintf(stderr, "filters: could not pin thread %d\n", index);
+#endif
+
+	pthread_mutex_lock(&mt_mutex);
+	while (1) {
+		while (mt_frame == frame_done && !mt_exit)
+			pthread_cond_wait(&mt_cond_start, &mt_mutex);
+		if (mt_exit)
+			break;
+
+		frame_done = mt_frame;
+		job = mt_job;
+		pthread_mutex_unlock(&mt_mutex);
+
+		/* neighbour lines outside the band are only read,
+		 * so bands don't need any overlap in the output */
+		y = job.height * index / thread_count;
+		y_end = job.height * (index + 1) / thread_count;
+		if (y < y_end)
+			filter_job_lines(&job, y, y_end);
+
+		pthread_mutex_lock(&mt_mutex);
+		if (--mt_pending == 0)
+			pthread_cond_signal(&mt_cond_done);
+	}
+	pthread_mutex_unlock(&mt_mutex);
+
+	filter_scratch_free();
+	return NULL;
+}
+
+int filter_threads_init(int count)
+{
+	int i;
+
+	if (thread_count > 0)
+		filter_threads_finish();
+
+	if (count <= 0)
+		count = sysconf(_SC_NPROCESSORS_ONLN);
+	if (count > MAX_THREADS)
+		count = MAX_THREADS;
+	if (count <= 1)
+		return 1;	/* filter_threads_start() will do it inline */
+
+	mt_exit = 0;
+	mt_pending = 0;
+	mt_frame = 0;
+	thread_count = count;
+	for (i = 0; i < count; i++) {
+		if (pthread_create(&threads[i], NULL, filter_thread, (void *)(long)i) != 0) {
+			fprintf(stderr, "filters: pthread_create failed\n");
+			thread_count = i;
+			filter_threads_finish();
+			return 1;
+		}
+	}
+
+	fprintf(stderr, "filters: %d threads\n", count);
+	return count;
+}
+
+void filter_threads_start(const struct filter_job *job)
+{
+	if (thread_count == 0) {
+		filter_job_lines(job, 0, job->height);
+		return;
+	}
+
+	pthread_mutex_lock(&mt_mutex);
+	/* previous frame must be done, as we might reuse its buffers */
+	while (mt_pending > 0)
+		pthread_cond_wait(&mt_cond_done, &mt_mutex);
+	mt_job = *job;
+	mt_pending = thread_count;
+	mt_frame++;
+	pthread_cond_broadcast(&mt_cond_start);
+	pthread_mutex_unlock(&mt_mutex);
+}
+
+void filter_threads_wait(void)
+{
+	if (thread_count == 0)
+		return;
+
+	pthread_mutex_lock(&mt_mutex);
+	while (mt_pending > 0)
+		pthread_cond_wait(&mt_cond_done, &mt_mutex);
+	pthread_mutex_unlock(&mt_mutex);
+}
+
+void filter_threads_finish(void)
+{
+	int i;
+
+	if (thread_count == 0)
+		return;
+
+	filter_threads_wait();
+
+	pthread_mutex_lock(&mt_mutex);
+	mt_exit = 1;
+	pthread_cond_broadcast(&mt_cond_start);
+	pthread_mutex_unlock(&mt_mutex);
+
+	for (i = 0; i < thread_count; i++)
+		pthread_join(threads[i], NULL);
+	thread_count = 0;
+}
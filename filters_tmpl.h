@@ -0,0 +1,211 @@
+/*
+ * vector line kernels, shared by the SIMD filter implementations.
+ * The includer defines:
+ *  V             - vector type, VB - its size in bytes
+ *  V_ATTR        - function attributes (target selection)
+ *  V_LOAD/V_STORE(p[, v]) - unaligned access
+ *  V_CMPEQ8/V_CMPEQ16(a, b) - lanewise compare, all ones if equal
+ *  V_AND/V_OR(a, b), V_ANDNOT(a, b) - (~a & b)
+ *  V_SEL(m, a, b) - m ? a : b, bitwise
+ *  V_ZIP8/V_ZIP16(a, b, lo, hi) - interleave a and b into lo, hi
+ *  V_STORE3_8/V_STORE3_16(p, a, b, c) - optional, store a, b, c
+ *                  3-way interleaved (3 vectors worth)
+ *  V_LINES       - name of the resulting struct filter_lines
+ * Line edges are done by the scalar code from filters_int.h.
+ */
+
+#ifndef V_STORE3_8
+/* no 3-way interleave instruction, go through memory */
+#define V_STORE3_T(p, a, b, c, type) { \
+	type ta_[VB / sizeof(type)], tb_[VB / sizeof(type)], tc_[VB / sizeof(type)]; \
+	type *p_ = p; \
+	unsigned int i_; \
+	V_STORE(ta_, a); \
+	V_STORE(tb_, b); \
+	V_STORE(tc_, c); \
+	for (i_ = 0; i_ < VB / sizeof(type); i_++, p_ += 3) { \
+		p_[0] = ta_[i_]; \
+		p_[1] = tb_[i_]; \
+		p_[2] = tc_[i_]; \
+	} \
+}
+#define V_STORE3_8(p, a, b, c)  V_STORE3_T(p, a, b, c, uint8_t)
+#define V_STORE3_16(p, a, b, c) V_STORE3_T(p, a, b, c, uint16_t)
+#endif
+
+#define V_SCALE2X_LINE(name, type, cmpeq, zip, cname) \
+V_ATTR static void name(type *d0, unsigned int ds, const type *b, \
+	const type *e, const type *h, unsigned int w) \
+{ \
+	const unsigned int n = VB / sizeof(type); \
+	type *d1 = FILTER_LINE(d0, 1, ds); \
+	unsigned int x = 1; \
+\
+	if (w < n + 2) { \
+		cname(d0, ds, b, e, h, 0, w, w); \
+		return; \
+	} \
+	cname(d0, ds, b, e, h, 0, 1, w); \
+\
+	for (; x + n < w; x += n) { \
+		V B = V_LOAD(b + x), H = V_LOAD(h + x), E = V_LOAD(e + x); \
+		V D = V_LOAD(e + x - 1), F = V_LOAD(e + x + 1); \
+		V c, e0, e1, e2, e3, lo, hi; \
+\
+		/* keep E where < B == H || D == F > */ \
+		c  = V_OR(cmpeq(B, H), cmpeq(D, F)); \
+		e0 = V_SEL(V_ANDNOT(c, cmpeq(D, B)), D, E); \
+		e1 = V_SEL(V_ANDNOT(c, cmpeq(B, F)), F, E); \
+		e2 = V_SEL(V_ANDNOT(c, cmpeq(D, H)), D, E); \
+		e3 = V_SEL(V_ANDNOT(c, cmpeq(H, F)), F, E); \
+\
+		zip(e0, e1, lo, hi); \
+		V_STORE(d0 + x * 2, lo); \
+		V_STORE(d0 + x * 2 + n, hi); \
+		zip(e2, e3, lo, hi); \
+		V_STORE(d1 + x * 2, lo); \
+		V_STORE(d1 + x * 2 + n, hi); \
+	} \
+\
+	cname(d0, ds, b, e, h, x, w, w); \
+}
+
+#define V_EAGLE2X_LINE(name, type, cmpeq, zip, cname) \
+V_ATTR static void name(type *d0, unsigned int ds, const type *b, \
+	const type *e, const type *h, unsigned int w) \
+{ \
+	const unsigned int n = VB / sizeof(type); \
+	type *d1 = FILTER_LINE(d0, 1, ds); \
+	unsigned int x = 1; \
+\
+	if (w < n + 2) { \
+		cname(d0, ds, b, e, h, 0, w, w); \
+		return; \
+	} \
+	cname(d0, ds, b, e, h, 0, 1, w); \
+\
+	for (; x + n < w; x += n) { \
+		V S = V_LOAD(b + x - 1), T = V_LOAD(b + x), U = V_LOAD(b + x + 1); \
+		V V_ = V_LOAD(e + x - 1), C = V_LOAD(e + x), W = V_LOAD(e + x + 1); \
+		V X = V_LOAD(h + x - 1), Y = V_LOAD(h + x), Z = V_LOAD(h + x + 1); \
+		V e1, e2, e3, e4, lo, hi; \
+\
+		e1 = V_SEL(V_AND(cmpeq(S, T), cmpeq(S, V_)), T, C); \
+		e2 = V_SEL(V_AND(cmpeq(U, T), cmpeq(U, W)), T, C); \
+		e3 = V_SEL(V_AND(cmpeq(X, Y), cmpeq(X, V_)), Y, C); \
+		e4 = V_SEL(V_AND(cmpeq(Z, Y), cmpeq(Z, W)), Y, C); \
+\
+		zip(e1, e2, lo, hi); \
+		V_STORE(d0 + x * 2, lo); \
+		V_STORE(d0 + x * 2 + n, hi); \
+		zip(e3, e4, lo, hi); \
+		V_STORE(d1 + x * 2, lo); \
+		V_STORE(d1 + x * 2 + n, hi); \
+	} \
+\
+	cname(d0, ds, b, e, h, x, w, w); \
+}
+
+#define V_SCALE3X_LINE(name, type, cmpeq, store3, cname) \
+V_ATTR static void name(type *d0, unsigned int ds, const type *b, \
+	const type *e, const type *h, unsigned int w) \
+{ \
+	const unsigned int n = VB / sizeof(type); \
+	type *d1 = FILTER_LINE(d0, 1, ds); \
+	type *d2 = FILTER_LINE(d0, 2, ds); \
+	unsigned int x = 1; \
+\
+	if (w < n + 2) { \
+		cname(d0, ds, b, e, h, 0, w, w); \
+		return; \
+	} \
+	cname(d0, ds, b, e, h, 0, 1, w); \
+\
+	for (; x + n < w; x += n) { \
+		V A = V_LOAD(b + x - 1), B = V_LOAD(b + x), C = V_LOAD(b + x + 1); \
+		V D = V_LOAD(e + x - 1), E = V_LOAD(e + x), F = V_LOAD(e + x + 1); \
+		V G = V_LOAD(h + x - 1), H = V_LOAD(h + x), I = V_LOAD(h + x + 1); \
+		V c, db, bf, dh, hf, ea, ec, eg, ei; \
+		V e0, e1, e2, e3, e5, e6, e7, e8; \
+\
+		c  = V_OR(cmpeq(B, H), cmpeq(D, F)); \
+		db = V_ANDNOT(c, cmpeq(D, B)); \
+		bf = V_ANDNOT(c, cmpeq(B, F)); \
+		dh = V_ANDNOT(c, cmpeq(D, H)); \
+		hf = V_ANDNOT(c, cmpeq(H, F)); \
+		ea = cmpeq(E, A); ec = cmpeq(E, C); \
+		eg = cmpeq(E, G); ei = cmpeq(E, I); \
+\
+		e0 = V_SEL(db, D, E); \
+		e1 = V_SEL(V_OR(V_ANDNOT(ec, db), V_ANDNOT(ea, bf)), B, E); \
+		e2 = V_SEL(bf, F, E); \
+		e3 = V_SEL(V_OR(V_ANDNOT(eg, db), V_ANDNOT(ea, dh)), D, E); \
+		e5 = V_SEL(V_OR(V_ANDNOT(ei, bf), V_ANDNOT(ec, hf)), F, E); \
+		e6 = V_SEL(dh, D, E); \
+		e7 = V_SEL(V_OR(V_ANDNOT(ei, dh), V_ANDNOT(eg, hf)), H, E); \
+		e8 = V_SEL(hf, F, E); \
+\
+		store3(d0 + x * 3, e0, e1, e2); \
+		store3(d1 + x * 3, e3, E, e5); \
+		store3(d2 + x * 3, e6, e7, e8); \
+	} \
+\
+	cname(d0, ds, b, e, h, x, w, w); \
+}
+
+#define V_EAGLE3X_LINE(name, type, cmpeq, store3, cname) \
+V_ATTR static void name(type *d0, unsigned int ds, const type *b, \
+	const type *e, const type *h, unsigned int w) \
+{ \
+	const unsigned int n = VB / sizeof(type); \
+	type *d1 = FILTER_LINE(d0, 1, ds); \
+	type *d2 = FILTER_LINE(d0, 2, ds); \
+	unsigned int x = 1; \
+\
+	if (w < n + 2) { \
+		cname(d0, ds, b, e, h, 0, w, w); \
+		return; \
+	} \
+	cname(d0, ds, b, e, h, 0, 1, w); \
+\
+	for (; x + n < w; x += n) { \
+		V S = V_LOAD(b + x - 1), T = V_LOAD(b + x), U = V_LOAD(b + x + 1); \
+		V V_ = V_LOAD(e + x - 1), C = V_LOAD(e + x), W = V_LOAD(e + x + 1); \
+		V X = V_LOAD(h + x - 1), Y = V_LOAD(h + x), Z = V_LOAD(h + x + 1); \
+		V tl, tr, bl, br; \
+\
+		tl = V_AND(cmpeq(S, T), cmpeq(S, V_)); \
+		tr = V_AND(cmpeq(U, T), cmpeq(U, W)); \
+		bl = V_AND(cmpeq(X, Y), cmpeq(X, V_)); \
+		br = V_AND(cmpeq(Z, Y), cmpeq(Z, W)); \
+\
+		store3(d0 + x * 3, V_SEL(tl, T, C), V_SEL(V_AND(tl, tr), T, C), \
+			V_SEL(tr, T, C)); \
+		store3(d1 + x * 3, V_SEL(V_AND(tl, bl), V_, C), C, \
+			V_SEL(V_AND(tr, br), W, C)); \
+		store3(d2 + x * 3, V_SEL(bl, Y, C), V_SEL(V_AND(bl, br), Y, C), \
+			V_SEL(br, Y, C)); \
+	} \
+\
+	cname(d0, ds, b, e, h, x, w, w); \
+}
+
+V_SCALE2X_LINE(v_scale2x_line8,  uint8_t,  V_CMPEQ8,  V_ZIP8,  scale2x_line8_c)
+V_SCALE2X_LINE(v_scale2x_line16, uint16_t, V_CMPEQ16, V_ZIP16, scale2x_line16_c)
+V_EAGLE2X_LINE(v_eagle2x_line8,  uint8_t,  V_CMPEQ8,  V_ZIP8,  eagle2x_line8_c)
+V_EAGLE2X_LINE(v_eagle2x_line16, uint16_t, V_CMPEQ16, V_ZIP16, eagle2x_line16_c)
+V_SCALE3X_LINE(v_scale3x_line8,  uint8_t,  V_CMPEQ8,  V_STORE3_8,  scale3x_line8_c)
+V_SCALE3X_LINE(v_scale3x_line16, uint16_t, V_CMPEQ16, V_STORE3_16, scale3x_line16_c)
+V_EAGLE3X_LINE(v_eagle3x_line8,  uint8_t,  V_CMPEQ8,  V_STORE3_8,  eagle3x_line8_c)
+V_EAGLE3X_LINE(v_eagle3x_line16, uint16_t, V_CMPEQ16, V_STORE3_16, eagle3x_line16_c)
+
+const struct filter_lines V_LINES = {
+	v_scale2x_line8,
+	v_scale2x_line16,
+	v_eagle2x_line8,
+	v_eagle2x_line16,
+	v_scale3x_line8,
+	v_scale3x_line16,
+	v_eagle3x_line8,
+	v_eagle3x_line16,
+};
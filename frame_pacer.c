@@ -0,0 +1,209 @@
+/*
+ * frame pacer, hybrid sleep/spin on CLOCK_MONOTONIC
+ *
+ * This work is licensed under the terms of any of these licenses
+ * (at your option):
+ *  - GNU GPL, version 2 or later.
+ *  - GNU LGPL, version 2.1 or later.
+ *  - MAME license.
+ * See the COPYING file in the top-level directory.
+ */
+
+#include <string.h>
+#include <stdint.h>
+#include <time.h>
+#include <errno.h>
+
+#include "plat.h"
+#include "frame_pacer.h"
+#include "vout_stats.h"
+
+#define NS_PER_SEC	1000000000ull
+
+/* spin margin bounds, it follows the measured sleep overshoot */
+#define SPIN_MIN_NS	50000
+#define SPIN_MAX_NS	2000000
+#define SPIN_SLACK_NS	50000
+
+/* give up catching up after this many frames */
+#define RESYNC_FRAMES	4
+
+static struct {
+	unsigned int num, den;
+	int lock_refresh;
+	unsigned int locked_us;		/* display period followed, 0 if none */
+	/* frame n is due at base_ns + n * period_num / period_den */
+	uint64_t base_ns;
+	uint64_t period_num;
+	unsigned int period_den;
+	unsigned int count;
+	int running;
+	int64_t spin_ns;
+	struct frame_pacer_stats stats;
+} pacer = {
+	.num = 60, .den = 1,
+	.period_num = NS_PER_SEC, .period_den = 60,
+	.spin_ns = SPIN_MAX_NS / 2,
+};
+
+static unsigned int gcd(unsigned int a, unsigned int b)
+{
+	while (b != 0) {
+		unsigned int t = a % b;
+		a = b;
+		b = t;
+	}
+	return a;
+}
+
+static uint64_t due_ns(unsigned int count)
+{
+	return pacer.base_ns + count * pacer.period_num / pacer.period_den;
+}
+
+/* keeps the current frame's deadline, later ones use the new period */
+static void set_period(uint64_t num, unsigned int den)
+{
+	if (num == pacer.period_num && den == pacer.period_den)
+		return;
+
+	pacer.base_ns = due_ns(pacer.count);
+	pacer.count = 0;
+	pacer.period_num = num;
+	pacer.period_den = den;
+}
+
+void frame_pacer_set_rate(unsigned int num, unsigned int den)
+{
+	unsigned int d;
+
+	if (num == 0 || den == 0)
+		return;
+
+	d = gcd(num, den);
+	pacer.num = num / d;
+	pacer.den = den / d;
+	pacer.locked_us = 0;
+	set_period((uint64_t)pacer.den * NS_PER_SEC, pacer.num);
+}
+
+void frame_pacer_set_lock_refresh(int enable)
+{
+	pacer.lock_refresh = enable;
+	if (!enable && pacer.locked_us != 0) {
+		pacer.locked_us = 0;
+		set_period((uint64_t)pacer.den * NS_PER_SEC, pacer.num);
+	}
+}
+
+static void update_lock(void)
+{
+	uint64_t nominal_us = (uint64_t)pacer.den * 1000000 / pacer.num;
+	unsigned int refresh_us = vout_stats_refresh_us();
+	uint64_t diff;
+
+	diff = refresh_us > nominal_us ? refresh_us - nominal_us : nominal_us - refresh_us;
+	if (refresh_us == 0 || diff * 100 > nominal_us)
+		refresh_us = 0;
+
+	if (refresh_us == pacer.locked_us)
+		return;
+
+	pacer.locked_us = refresh_us;
+	if (refresh_us != 0)
+		set_period((uint64_t)refresh_us * 1000, 1);
+	else
+		set_period((uint64_t)pacer.den * NS_PER_SEC, pacer.num);
+}
+
+static void sleep_till(uint64_t t)
+{
+	struct timespec ts;
+
+	ts.tv_sec = t / NS_PER_SEC;
+	ts.tv_nsec = t % NS_PER_SEC;
+	while (clock_nanosleep(CLOCK_MONOTONIC, TIMER_ABSTIME, &ts, NULL) == EINTR)
+		;
+}
+
+int frame_pacer_wait(void)
+{
+	uint64_t now, due, wake_at, period;
+	int64_t overshoot;
+	unsigned int us;
+
+	if (pacer.lock_refresh)
+		update_lock();
+
+	now = plat_get_ticks_ns();
+	if (!pacer.running) {
+		pacer.base_ns = now;
+		pacer.count = 0;
+		pacer.running = 1;
+		return 0;
+	}
+
+	// period_den frames take exactly period_num ns, rebase there
+	// so that count * period_num can't overflow
+	if (++pacer.count == pacer.period_den) {
+		pacer.base_ns += pacer.period_num;
+		pacer.count = 0;
+	}
+	due = due_ns(pacer.count);
+	pacer.stats.frames++;
+
+	if (now >= due) {
+		period = pacer.period_num / pacer.period_den;
+		us = (now - due) / 1000;
+		pacer.stats.late++;
+		if (us > pacer.stats.late_max_us)
+			pacer.stats.late_max_us = us;
+
+		if (now - due >= period * RESYNC_FRAMES) {
+			// don't try to catch up with a burst of frames
+			pacer.base_ns = now;
+			pacer.count = 0;
+			pacer.stats.resyncs++;
+			return 0;
+		}
+		return (now - due) / period;
+	}
+
+	wake_at = due - pacer.spin_ns;
+	if (wake_at > now) {
+		sleep_till(wake_at);
+		now = plat_get_ticks_ns();
+
+		// grow the margin right away, shrink it slowly
+		overshoot = now - wake_at + SPIN_SLACK_NS;
+		if (overshoot > pacer.spin_ns)
+			pacer.spin_ns = overshoot;
+		else
+			pacer.spin_ns -= (pacer.spin_ns - overshoot) / 16;
+		if (pacer.spin_ns < SPIN_MIN_NS)
+			pacer.spin_ns = SPIN_MIN_NS;
+		if (pacer.spin_ns > SPIN_MAX_NS)
+			pacer.spin_ns = SPIN_MAX_NS;
+	}
+
+	while (now < due)
+		now = plat_get_ticks_ns();
+
+	us = (now - due) / 1000;
+	if (us > pacer.stats.wake_err_max_us)
+		pacer.stats.wake_err_max_us = us;
+
+	return 0;
+}
+
+void frame_pacer_reset(void)
+{
+	pacer.running = 0;
+}
+
+void frame_pacer_get_stats(struct frame_pacer_stats *s)
+{
+	*s = pacer.stats;
+	s->spin_us = pacer.spin_ns / 1000;
+	s->period_us = pacer.period_num / pacer.period_den / 1000;
+}
@@ -0,0 +1,47 @@
+#ifndef LIBPICOFE_FRAME_PACER_H
+#define LIBPICOFE_FRAME_PACER_H
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/*
+ * Frame pacing for hosts that can't (or don't) block on vsync.
+ * frame_pacer_wait() sleeps until the next frame is due, waking a bit
+ * early and spinning out the rest, so frame times don't jitter with
+ * the scheduler. The schedule is absolute, so rounding doesn't drift.
+ */
+
+struct frame_pacer_stats {
+	unsigned int frames;
+	unsigned int late;		/* frames that were already due at wait */
+	unsigned int resyncs;		/* fell too far behind, schedule restarted */
+	unsigned int late_max_us;
+	unsigned int wake_err_max_us;	/* worst wakeup past the deadline */
+	unsigned int spin_us;		/* current spin margin */
+	unsigned int period_us;		/* current frame period */
+};
+
+/* rate is num/den frames per second: 60/1, 50/1, 60000/1001 */
+void frame_pacer_set_rate(unsigned int num, unsigned int den);
+
+/* follow the display refresh measured by vout_stats when it's within
+ * 1% of the rate (59.94 content on a 60Hz panel and such); only with
+ * a vsync source or a set refresh, else the intervals would be the
+ * pacer's own */
+void frame_pacer_set_lock_refresh(int enable);
+
+/* wait for the next frame, returns how many frames behind schedule
+ * the caller is (0 when on time), for frameskip decisions */
+int  frame_pacer_wait(void);
+
+/* restart the schedule, after a pause or a menu */
+void frame_pacer_reset(void);
+
+void frame_pacer_get_stats(struct frame_pacer_stats *s);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* LIBPICOFE_FRAME_PACER_H */
@@ -1,10 +1,15 @@
 #include <stdio.h>
 #include <stdlib.h>
+#include <string.h>
 
 #include <EGL/egl.h>
 #include <GLES/gl.h>
+#include <GLES/glext.h>
 #include "gl_platform.h"
 #include "gl.h"
+#include "plat.h"
+#include "vout_stats.h"
+#include "gl_shader.h"
 
 static EGLDisplay edpy;
 static EGLSurface esfc;
@@ -14,9 +19,32 @@ static EGLContext ectxt;
 void *gl_es_display;
 void *gl_es_surface;
 
+/* GLES2 or 3 context, drawing is done by gl_shader.c */
+static int gl_es2;
+static int gl_shader_sel;
+
+/* only the fixed pipeline code below calls GLES1 directly */
+static const struct gl_funcs gl_es1_funcs = {
+	glGetError,
+	glGetString,
+	glGetIntegerv,
+	glClear,
+	glGenTextures,
+	glBindTexture,
+	glTexParameterf,
+	glPixelStorei,
+	glTexImage2D,
+	glTexSubImage2D,
+	glGenBuffers,
+	glDeleteBuffers,
+	glBindBuffer,
+	glBufferData,
+};
+static const struct gl_funcs *glf = &gl_es1_funcs;
+
 static int gl_have_error(const char *name)
 {
-	GLenum e = glGetError();
+	GLenum e = glf->glGetError();
 	if (e != GL_NO_ERROR) {
 		fprintf(stderr, "GL error: %s %x\n", name, e);
 		return 1;
@@ -24,6 +52,375 @@ static int gl_have_error(const char *name)
 	return 0;
 }
 
+static int gl_have_extension(const char *name)
+{
+	const char *ext = (const char *)glf->glGetString(GL_EXTENSIONS);
+	size_t len = strlen(name);
+
+	while (ext != NULL && (ext = strstr(ext, name)) != NULL) {
+		if (ext[len] == ' ' || ext[len] == 0)
+			return 1;
+		ext += len;
+	}
+	return 0;
+}
+
+/* major version of the current context, 1 for "OpenGL ES-CM 1.1" */
+static int gl_es_version(void)
+{
+	const char *ver = (const char *)glf->glGetString(GL_VERSION);
+
+	// "OpenGL ES N.M ..."
+	if (ver != NULL && strncmp(ver, "OpenGL ES ", 10) == 0)
+		return atoi(ver + 10);
+	return 1;
+}
+
+/*
+ * Streaming uploads through a ring of pixel unpack buffers (GLES3, which
+ * gl_init() asks for first, or GL_NV_pixel_buffer_object). The frame is
+ * copied into a freshly invalidated buffer and glTexSubImage2D then
+ * only queues a copy from it, so the driver doesn't have to block until
+ * it's done with the client memory. The buffer of the previous frame(s)
+ * may still be in use by the GPU, which is why there's more than one.
+ */
+#ifndef GL_PIXEL_UNPACK_BUFFER
+#define GL_PIXEL_UNPACK_BUFFER		0x88EC
+#endif
+#ifndef GL_STREAM_DRAW
+#define GL_STREAM_DRAW			0x88E0
+#endif
+#ifndef GL_MAP_WRITE_BIT
+#define GL_MAP_WRITE_BIT		0x0002
+#endif
+#ifndef GL_MAP_INVALIDATE_BUFFER_BIT
+#define GL_MAP_INVALIDATE_BUFFER_BIT	0x0008
+#endif
+
+#define PBO_COUNT 3
+
+typedef void *(GL_APIENTRY *map_buffer_range_t)(GLenum target,
+	GLintptr offset, GLsizeiptr length, GLbitfield access);
+typedef GLboolean (GL_APIENTRY *unmap_buffer_t)(GLenum target);
+
+static map_buffer_range_t pglMapBufferRange;
+static unmap_buffer_t pglUnmapBuffer;
+
+static GLuint pbos[PBO_COUNT];
+static int pbo_sizes[PBO_COUNT];
+static int pbo_next;
+static int pbo_enabled;
+
+static void gl_pbo_init(void)
+{
+	pbo_enabled = 0;
+	pbo_next = 0;
+	memset(pbo_sizes, 0, sizeof(pbo_sizes));
+
+	if (gl_es_version() >= 3) {
+		pglMapBufferRange = (map_buffer_range_t)
+			eglGetProcAddress("glMapBufferRange");
+		pglUnmapBuffer = (unmap_buffer_t)
+			eglGetProcAddress("glUnmapBuffer");
+	}
+	else if (gl_have_extension("GL_NV_pixel_buffer_object")
+		 && gl_have_extension("GL_EXT_map_buffer_range"))
+	{
+		pglMapBufferRange = (map_buffer_range_t)
+			eglGetProcAddress("glMapBufferRangeEXT");
+		pglUnmapBuffer = (unmap_buffer_t)
+			eglGetProcAddress("glUnmapBufferOES");
+	}
+	else
+		return;
+
+	if (pglMapBufferRange == NULL || pglUnmapBuffer == NULL)
+		return;
+
+	glf->glGenBuffers(PBO_COUNT, pbos);
+	if (gl_have_error("glGenBuffers"))
+		return;
+
+	pbo_enabled = 1;
+}
+
+static void gl_pbo_finish(void)
+{
+	if (pbo_enabled)
+		glf->glDeleteBuffers(PBO_COUNT, pbos);
+	pbo_enabled = 0;
+}
+
+/* maps the next buffer for writing, NULL means use the direct path */
+static void *gl_pbo_map(int size)
+{
+	int i = pbo_next;
+	void *dst;
+
+	if (!pbo_enabled)
+		return NULL;
+
+	pbo_next = (pbo_next + 1) % PBO_COUNT;
+
+	glf->glBindBuffer(GL_PIXEL_UNPACK_BUFFER, pbos[i]);
+	if (pbo_sizes[i] < size) {
+		glf->glBufferData(GL_PIXEL_UNPACK_BUFFER, size, NULL,
+			GL_STREAM_DRAW);
+		pbo_sizes[i] = size;
+	}
+
+	dst = pglMapBufferRange(GL_PIXEL_UNPACK_BUFFER, 0, size,
+		GL_MAP_WRITE_BIT | GL_MAP_INVALIDATE_BUFFER_BIT);
+	if (dst == NULL) {
+		fprintf(stderr, "GL: PBO map failed, using direct uploads\n");
+		glf->glBindBuffer(GL_PIXEL_UNPACK_BUFFER, 0);
+		gl_have_error("glMapBufferRange");
+		gl_pbo_finish();
+	}
+	return dst;
+}
+
+static void gl_pbo_upload(int w, int h, GLenum format, GLenum type)
+{
+	pglUnmapBuffer(GL_PIXEL_UNPACK_BUFFER);
+	glf->glTexSubImage2D(GL_TEXTURE_2D, 0, 0, 0, w, h, format, type,
+		NULL);
+	glf->glBindBuffer(GL_PIXEL_UNPACK_BUFFER, 0);
+}
+
+/*
+ * The frame texture, sized to the frame (or the next power of two if
+ * the driver can't do NPOT) and reallocated when that changes.
+ * XRGB8888 goes up as BGRA if the driver takes it, else it's swizzled
+ * to RGBA while copying. 8bit frames are expanded through the palette,
+ * which is kept in the same byte order as the texture, or with GLES2
+ * uploaded as is and looked up in a palette texture by the shaders.
+ */
+#ifndef GL_BGRA_EXT
+#define GL_BGRA_EXT			0x80E1
+#endif
+
+static struct {
+	GLuint name;
+	int w, h;		/* allocated size */
+	int fb_w, fb_h;		/* part that's in use */
+	GLenum format;
+	GLenum type;
+	int bpp;
+} tex;
+
+static float vertices[] = {
+	-1.0f,  1.0f,  0.0f, // 0    0  1
+	 1.0f,  1.0f,  0.0f, // 1  ^
+	-1.0f, -1.0f,  0.0f, // 2  | 2  3
+	 1.0f, -1.0f,  0.0f, // 3  +-->
+};
+
+static float texture[] = {
+	0.0f, 0.0f, // we flip this:
+	1.0f, 0.0f, // v^
+	0.0f, 1.0f, //  |  u
+	1.0f, 1.0f, //  +-->
+};
+
+static int have_npot;
+static int have_bgra;
+static int max_tex_size;
+
+static uint32_t palette_xrgb[256];
+static uint32_t palette[256];
+static void *conv_buf;
+static int conv_buf_size;
+
+static int pot(int v)
+{
+	int p = 1;
+
+	while (p < v)
+		p <<= 1;
+	return p;
+}
+
+static void gl_tex_caps_init(void)
+{
+	GLint v = 0;
+
+	// limited NPOT (no mipmaps, clamp to edge) is all we need
+	have_npot = gl_es_version() >= 2
+		|| gl_have_extension("GL_OES_texture_npot")
+		|| gl_have_extension("GL_ARB_texture_non_power_of_two")
+		|| gl_have_extension("GL_IMG_texture_npot")
+		|| gl_have_extension("GL_APPLE_texture_2D_limited_npot");
+	have_bgra = gl_have_extension("GL_EXT_texture_format_BGRA8888")
+		|| gl_have_extension("GL_APPLE_texture_format_BGRA8888");
+
+	glf->glGetIntegerv(GL_MAX_TEXTURE_SIZE, &v);
+	max_tex_size = v > 0 ? v : 1024;
+
+	memset(&tex, 0, sizeof(tex));
+}
+
+static void gl_fmt_params(int fmt, GLenum *format, GLenum *type, int *bpp)
+{
+	if (fmt == GL_FMT_RGB565) {
+		*format = GL_RGB;
+		*type = GL_UNSIGNED_SHORT_5_6_5;
+		*bpp = 2;
+	}
+	else if (fmt == GL_FMT_PAL8 && gl_es2) {
+		// palette is applied by the shader
+		*format = GL_LUMINANCE;
+		*type = GL_UNSIGNED_BYTE;
+		*bpp = 1;
+	}
+	else {
+		*format = have_bgra ? GL_BGRA_EXT : GL_RGBA;
+		*type = GL_UNSIGNED_BYTE;
+		*bpp = 4;
+	}
+}
+
+static int gl_tex_setup(int w, int h, int fmt)
+{
+	int tw = have_npot ? w : pot(w);
+	int th = have_npot ? h : pot(h);
+	GLenum format, type;
+	void *zeroes;
+	int bpp;
+
+	gl_fmt_params(fmt, &format, &type, &bpp);
+
+	if (tw == tex.w && th == tex.h && format == tex.format
+	    && type == tex.type)
+		goto texcoords;
+
+	if (tw > max_tex_size || th > max_tex_size) {
+		fprintf(stderr, "GL: %dx%d frame doesn't fit in a %dx%d texture\n",
+			w, h, max_tex_size, max_tex_size);
+		return -1;
+	}
+
+	// cleared, so that linear filtering doesn't pull in junk at the edges
+	zeroes = calloc(1, tw * th * bpp);
+	if (zeroes == NULL) {
+		fprintf(stderr, "OOM\n");
+		return -1;
+	}
+	glf->glTexImage2D(GL_TEXTURE_2D, 0, format, tw, th, 0, format, type,
+		zeroes);
+	free(zeroes);
+	if (gl_have_error("glTexImage2D")) {
+		tex.w = tex.h = 0;
+		return -1;
+	}
+
+	tex.w = tw;
+	tex.h = th;
+	tex.format = format;
+	tex.type = type;
+	tex.bpp = bpp;
+	tex.fb_w = tex.fb_h = 0;
+
+texcoords:
+	if (w != tex.fb_w || h != tex.fb_h) {
+		float f_w = (float)w / tw;
+		float f_h = (float)h / th;
+		texture[1*2 + 0] = f_w;
+		texture[2*2 + 1] = f_h;
+		texture[3*2 + 0] = f_w;
+		texture[3*2 + 1] = f_h;
+		tex.fb_w = w;
+		tex.fb_h = h;
+	}
+
+	return 0;
+}
+
+static void conv_xrgb8888_rgba(uint32_t *d, const uint32_t *s, int pixels)
+{
+	int i;
+
+	for (i = 0; i < pixels; i++) {
+		uint32_t p = s[i];
+		d[i] = 0xff000000 | ((p & 0xff) << 16) | (p & 0xff00)
+			| ((p >> 16) & 0xff);
+	}
+}
+
+static void gl_palette_update(void)
+{
+	int i;
+
+	// XRGB8888 already is BGRA in memory
+	if (have_bgra) {
+		for (i = 0; i < 256; i++)
+			palette[i] = palette_xrgb[i] | 0xff000000;
+	}
+	else
+		conv_xrgb8888_rgba(palette, palette_xrgb, 256);
+
+#ifdef HAVE_GLES2
+	if (gl_es2)
+		gl_shader_set_palette(palette, have_bgra ? GL_BGRA_EXT : GL_RGBA);
+#endif
+}
+
+static void conv_pal8(uint32_t *d, const uint8_t *s, int pixels)
+{
+	int i;
+
+	for (i = 0; i < pixels; i++)
+		d[i] = palette[s[i]];
+}
+
+static int gl_need_conv(int fmt)
+{
+	return (fmt == GL_FMT_PAL8 && !gl_es2)
+		|| (fmt == GL_FMT_XRGB8888 && !have_bgra);
+}
+
+/* copies the frame to dst in texture format */
+static void gl_conv_frame(void *dst, const void *fb, int pixels, int fmt)
+{
+	if (!gl_need_conv(fmt))
+		memcpy(dst, fb, pixels * tex.bpp);
+	else if (fmt == GL_FMT_PAL8)
+		conv_pal8(dst, fb, pixels);
+	else
+		conv_xrgb8888_rgba(dst, fb, pixels);
+}
+
+static int gl_upload(const void *fb, int w, int h, int fmt)
+{
+	int size = w * h * tex.bpp;
+	void *dst;
+
+	dst = gl_pbo_map(size);
+	if (dst != NULL) {
+		gl_conv_frame(dst, fb, w * h, fmt);
+		gl_pbo_upload(w, h, tex.format, tex.type);
+		return gl_have_error("glTexSubImage2D") ? -1 : 0;
+	}
+
+	if (gl_need_conv(fmt)) {
+		if (conv_buf_size < size) {
+			free(conv_buf);
+			conv_buf = malloc(size);
+			conv_buf_size = conv_buf != NULL ? size : 0;
+			if (conv_buf == NULL) {
+				fprintf(stderr, "OOM\n");
+				return -1;
+			}
+		}
+		gl_conv_frame(conv_buf, fb, w * h, fmt);
+		fb = conv_buf;
+	}
+
+	glf->glTexSubImage2D(GL_TEXTURE_2D, 0, 0, 0, w, h,
+		tex.format, tex.type, fb);
+	return gl_have_error("glTexSubImage2D") ? -1 : 0;
+}
+
 static int gles_have_error(const char *name)
 {
 	EGLint e = eglGetError();
@@ -34,18 +431,91 @@ static int gles_have_error(const char *name)
 	return 0;
 }
 
-int gl_init(void *display, void *window, int *quirks)
+static int gl_create_context(void *window, const EGLint *attr,
+	const EGLint *ctx_attr)
 {
 	EGLConfig ecfg = NULL;
-	GLuint texture_name = 0;
-	void *tmp_texture_mem = NULL;
 	EGLint num_config;
+
+	if (!eglChooseConfig(edpy, attr, &ecfg, 1, &num_config)) {
+		fprintf(stderr, "Failed to choose config (%x)\n", eglGetError());
+		return -1;
+	}
+
+	if (ecfg == NULL || num_config == 0) {
+		fprintf(stderr, "No EGL configs available\n");
+		return -1;
+	}
+
+	esfc = eglCreateWindowSurface(edpy, ecfg,
+		(EGLNativeWindowType)window, NULL);
+	if (esfc == EGL_NO_SURFACE) {
+		fprintf(stderr, "Unable to create EGL surface (%x)\n",
+			eglGetError());
+		return -1;
+	}
+
+	ectxt = eglCreateContext(edpy, ecfg, EGL_NO_CONTEXT, ctx_attr);
+	if (ectxt == EGL_NO_CONTEXT) {
+		fprintf(stderr, "Unable to create EGL context (%x)\n",
+			eglGetError());
+		eglDestroySurface(edpy, esfc);
+		esfc = EGL_NO_SURFACE;
+		return -1;
+	}
+
+	return 0;
+}
+
+#ifdef HAVE_GLES2
+#ifndef EGL_OPENGL_ES3_BIT_KHR
+#define EGL_OPENGL_ES3_BIT_KHR		0x0040
+#endif
+
+/* GLES3 contexts need EGL 1.5 or EGL_KHR_create_context */
+static int egl_can_es3(void)
+{
+	const char *ver = eglQueryString(edpy, EGL_VERSION);
+	const char *ext = eglQueryString(edpy, EGL_EXTENSIONS);
+	int major = 0, minor = 0;
+
+	if (ver != NULL && sscanf(ver, "%d.%d", &major, &minor) == 2
+	    && (major > 1 || (major == 1 && minor >= 5)))
+		return 1;
+	return ext != NULL && strstr(ext, "EGL_KHR_create_context") != NULL;
+}
+#endif
+
+int gl_init(void *display, void *window, int *quirks)
+{
 	int retval = -1;
 	int ret;
 	EGLint attr[] =
 	{
 		EGL_NONE
 	};
+#ifdef HAVE_GLES2
+	EGLint attr_es3[] =
+	{
+		EGL_RENDERABLE_TYPE, EGL_OPENGL_ES3_BIT_KHR,
+		EGL_NONE
+	};
+	EGLint ctx_attr_es3[] =
+	{
+		EGL_CONTEXT_CLIENT_VERSION, 3,
+		EGL_NONE
+	};
+	EGLint attr_es2[] =
+	{
+		EGL_RENDERABLE_TYPE, EGL_OPENGL_ES2_BIT,
+		EGL_NONE
+	};
+	EGLint ctx_attr_es2[] =
+	{
+		EGL_CONTEXT_CLIENT_VERSION, 2,
+		EGL_NONE
+	};
+#endif
 
 	ret = gl_platform_init(&display, &window, quirks);
 	if (ret != 0) {
@@ -53,12 +523,6 @@ int gl_init(void *display, void *window, int *quirks)
 		goto out;
 	}
 
-	tmp_texture_mem = calloc(1, 1024 * 512 * 2);
-	if (tmp_texture_mem == NULL) {
-		fprintf(stderr, "OOM\n");
-		goto out;
-	}
-
 	edpy = eglGetDisplay((EGLNativeDisplayType)display);
 	if (edpy == EGL_NO_DISPLAY) {
 		fprintf(stderr, "Failed to get EGL display\n");
@@ -70,102 +534,118 @@ int gl_init(void *display, void *window, int *quirks)
 		goto out;
 	}
 
-	if (!eglChooseConfig(edpy, attr, &ecfg, 1, &num_config)) {
-		fprintf(stderr, "Failed to choose config (%x)\n", eglGetError());
-		goto out;
+	gl_es2 = 0;
+#ifdef HAVE_GLES2
+	// GLES3 (the shaders are GLSL ES 1.00, but it adds unpack buffers)
+	// or GLES2 for the shaders, fall back to the fixed pipeline
+	if (egl_can_es3()
+	    && gl_create_context(window, attr_es3, ctx_attr_es3) == 0)
+		gl_es2 = 1;
+	else if (gl_create_context(window, attr_es2, ctx_attr_es2) == 0)
+		gl_es2 = 1;
+	else {
+		fprintf(stderr, "GL: no GLES2, trying GLES1\n");
+		eglGetError();
 	}
-
-	if (ecfg == NULL || num_config == 0) {
-		fprintf(stderr, "No EGL configs available\n");
+	if (!gl_es2)
+#endif
+	if (gl_create_context(window, attr, NULL) != 0)
 		goto out;
-	}
+#ifdef HAVE_GLES2
+	glf = gl_es2 ? &gl_shader_funcs : &gl_es1_funcs;
+#endif
 
-	esfc = eglCreateWindowSurface(edpy, ecfg,
-		(EGLNativeWindowType)window, NULL);
-	if (esfc == EGL_NO_SURFACE) {
-		fprintf(stderr, "Unable to create EGL surface (%x)\n",
-			eglGetError());
-		goto out;
-	}
+	eglMakeCurrent(edpy, esfc, esfc, ectxt);
 
-	ectxt = eglCreateContext(edpy, ecfg, EGL_NO_CONTEXT, NULL);
-	if (ectxt == EGL_NO_CONTEXT) {
-		fprintf(stderr, "Unable to create EGL context (%x)\n",
-			eglGetError());
-		goto out;
-	}
+	// interval 1 (the default) makes swaps return at vblank
+	vout_stats_set_vsync(eglSwapInterval(edpy, 1) == EGL_TRUE);
 
-	eglMakeCurrent(edpy, esfc, esfc, ectxt);
+	gl_tex_caps_init();
+
+	if (gl_es2) {
+#ifdef HAVE_GLES2
+		if (gl_shader_init() != 0) {
+			fprintf(stderr, "GL: shader setup failed\n");
+			goto out;
+		}
+#endif
+	}
+	else {
+		glEnable(GL_TEXTURE_2D);
 
-	glEnable(GL_TEXTURE_2D);
+		//glViewport(0, 0, 512, 512);
+		glLoadIdentity();
+		glFrontFace(GL_CW);
+		glEnable(GL_CULL_FACE);
 
-	glGenTextures(1, &texture_name);
+		glEnableClientState(GL_TEXTURE_COORD_ARRAY);
+		glEnableClientState(GL_VERTEX_ARRAY);
+	}
 
-	glBindTexture(GL_TEXTURE_2D, texture_name);
+	glf->glGenTextures(1, &tex.name);
 
-	glTexImage2D(GL_TEXTURE_2D, 0, GL_RGB, 1024, 512, 0, GL_RGB,
-		GL_UNSIGNED_SHORT_5_6_5, tmp_texture_mem);
-	if (gl_have_error("glTexImage2D"))
-		goto out;
+	glf->glBindTexture(GL_TEXTURE_2D, tex.name);
 
 	// no mipmaps
-	glTexParameterf(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
-	glTexParameterf(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+	glf->glTexParameterf(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
+	glf->glTexParameterf(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+	glf->glTexParameterf(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+	glf->glTexParameterf(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+	// frames are tightly packed, RGB565 rows needn't be 4 byte aligned
+	glf->glPixelStorei(GL_UNPACK_ALIGNMENT, 1);
 
-	//glViewport(0, 0, 512, 512);
-	glLoadIdentity();
-	glFrontFace(GL_CW);
-	glEnable(GL_CULL_FACE);
-
-	glEnableClientState(GL_TEXTURE_COORD_ARRAY);
-	glEnableClientState(GL_VERTEX_ARRAY);
+	gl_palette_update();
 
 	if (gl_have_error("init"))
 		goto out;
 
+	gl_pbo_init();
+
 	gl_es_display = (void *)edpy;
 	gl_es_surface = (void *)esfc;
 	retval = 0;
 out:
-	free(tmp_texture_mem);
 	return retval;
 }
 
-static float vertices[] = {
-	-1.0f,  1.0f,  0.0f, // 0    0  1
-	 1.0f,  1.0f,  0.0f, // 1  ^
-	-1.0f, -1.0f,  0.0f, // 2  | 2  3
-	 1.0f, -1.0f,  0.0f, // 3  +-->
-};
+void gl_set_palette(const uint32_t *pal)
+{
+	memcpy(palette_xrgb, pal, sizeof(palette_xrgb));
+	gl_palette_update();
+}
 
-static float texture[] = {
-	0.0f, 0.0f, // we flip this:
-	1.0f, 0.0f, // v^
-	0.0f, 1.0f, //  |  u
-	1.0f, 1.0f, //  +-->
-};
+/* the choice is kept over gl_init()s, -1 if this context can't do it */
+int gl_set_shader(int shader)
+{
+	gl_shader_sel = shader;
+	return gl_es2 ? 0 : -1;
+}
 
-int gl_flip(const void *fb, int w, int h)
+int gl_flip_fmt(const void *fb, int w, int h, int fmt)
 {
-	static int old_w, old_h;
+	unsigned int frame_id = vout_stats_submit(0);
 
 	if (fb != NULL) {
-		if (w != old_w || h != old_h) {
-			float f_w = (float)w / 1024.0f;
-			float f_h = (float)h / 512.0f;
-			texture[1*2 + 0] = f_w;
-			texture[2*2 + 1] = f_h;
-			texture[3*2 + 0] = f_w;
-			texture[3*2 + 1] = f_h;
-			old_w = w;
-			old_h = h;
-		}
+		if (gl_tex_setup(w, h, fmt) != 0)
+			return -1;
+		if (gl_upload(fb, w, h, fmt) != 0)
+			return -1;
+	}
+
+	if (tex.w == 0) {
+		// nothing to show yet
+		glf->glClear(GL_COLOR_BUFFER_BIT);
+		goto swap;
+	}
 
-		glTexSubImage2D(GL_TEXTURE_2D, 0, 0, 0, w, h,
-			GL_RGB, GL_UNSIGNED_SHORT_5_6_5, fb);
-		if (gl_have_error("glTexSubImage2D"))
+#ifdef HAVE_GLES2
+	if (gl_es2) {
+		if (gl_shader_draw(tex.name, tex.fb_w, tex.fb_h, tex.w, tex.h,
+		    tex.format == GL_LUMINANCE, gl_shader_sel) != 0)
 			return -1;
+		goto swap;
 	}
+#endif
 
 	glVertexPointer(3, GL_FLOAT, 0, vertices);
 	glTexCoordPointer(2, GL_FLOAT, 0, texture);
@@ -174,15 +654,35 @@ int gl_flip(const void *fb, int w, int h)
 	if (gl_have_error("glDrawArrays"))
 		return -1;
 
+swap:
 	eglSwapBuffers(edpy, esfc);
 	if (gles_have_error("eglSwapBuffers"))
 		return -1;
 
+	// with swap interval 1 this returns at vblank, else it's a guess
+	vout_stats_present(frame_id, plat_get_ticks_ns());
+
 	return 0;
 }
 
+int gl_flip(const void *fb, int w, int h)
+{
+	return gl_flip_fmt(fb, w, h, GL_FMT_RGB565);
+}
+
 void gl_finish(void)
 {
+	gl_pbo_finish();
+#ifdef HAVE_GLES2
+	if (gl_es2)
+		gl_shader_finish();
+	gl_es2 = 0;
+	glf = &gl_es1_funcs;
+#endif
+	free(conv_buf);
+	conv_buf = NULL;
+	conv_buf_size = 0;
+
 	eglMakeCurrent(edpy, EGL_NO_SURFACE, EGL_NO_SURFACE, EGL_NO_CONTEXT);
 	eglDestroyContext(edpy, ectxt);
 	ectxt = EGL_NO_CONTEXT;
@@ -193,6 +693,7 @@ void gl_finish(void)
 
 	gl_es_display = (void *)edpy;
 	gl_es_surface = (void *)esfc;
+	vout_stats_set_vsync(0);
 
 	gl_platform_finish();
 }
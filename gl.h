@@ -1,7 +1,27 @@
+#include <stdint.h>
+
+/* frame formats for gl_flip_fmt() */
+#define GL_FMT_RGB565	0
+#define GL_FMT_XRGB8888	1
+#define GL_FMT_PAL8	2	/* palette set by gl_set_palette() */
+
+/* GPU filters for gl_set_shader(), need a GLES2 build (HAVE_GLES2) */
+#define GL_SHADER_NONE		0
+#define GL_SHADER_SCALE2X	1
+#define GL_SHADER_EAGLE2X	2
+#define GL_SHADER_SCALE3X	3
+#define GL_SHADER_EAGLE3X	4
+#define GL_SHADER_XBR2X		5
+#define GL_SHADER_COUNT		6
+#define GL_SHADER_CRT		0x100	/* or'able, scanlines + mask */
+
 #ifdef HAVE_GLES
 
 int gl_init(void *display, void *window, int *quirks);
 int gl_flip(const void *fb, int w, int h);
+int gl_flip_fmt(const void *fb, int w, int h, int fmt);
+void gl_set_palette(const uint32_t *pal);
+int gl_set_shader(int shader);
 void gl_finish(void);
 
 /* for external flips */
@@ -18,6 +38,17 @@ static __inline int gl_flip(const void *fb, int w, int h)
 {
   return -1;
 }
+static __inline int gl_flip_fmt(const void *fb, int w, int h, int fmt)
+{
+  return -1;
+}
+static __inline void gl_set_palette(const uint32_t *pal)
+{
+}
+static __inline int gl_set_shader(int shader)
+{
+  return -1;
+}
 static __inline void gl_finish(void)
 {
 }
@@ -26,5 +57,3 @@ static __inline void gl_finish(void)
 #define gl_es_surface (void *)0
 
 #endif
-
-#define GL_QUIRK_ACTIVATE_RECREATE 1
@@ -0,0 +1,514 @@
+/*
+ * GLES2 drawing for gl.c: frame filters and CRT effect as shaders
+ *
+ * This work is licensed under the terms of any of these licenses
+ * (at your option):
+ *  - GNU GPL, version 2 or later.
+ *  - GNU LGPL, version 2.1 or later.
+ *  - MAME license.
+ * See the COPYING file in the top-level directory.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <GLES2/gl2.h>
+#include "gl.h"
+#include "gl_shader.h"
+
+/*
+ * Up to two passes:
+ * 1. the frame, sampled with GL_NEAREST, goes through the selected
+ *    filter (or just the palette lookup) into an FBO texture of
+ *    scale * frame size. Skipped for unfiltered 16/32bpp frames.
+ *    If there's no FBO or the program doesn't build, 8bpp frames are
+ *    drawn in one pass through the palette, without interpolation.
+ * 2. the result is stretched to the screen with linear filtering,
+ *    optionally through the CRT shader.
+ * The filters follow the rules of the C kernels in filters_int.h, so
+ * the output at the filter's scale matches filters.c exactly.
+ */
+
+#define ATTR_POS	0
+#define ATTR_UV		1
+
+struct program {
+	GLuint prog;
+	GLint u_tex;
+	GLint u_pal;
+	GLint u_size;
+	GLint u_tex_size;
+	int failed;
+};
+
+struct filter_info {
+	const char *define;
+	int scale;
+};
+
+static const struct filter_info filters[GL_SHADER_COUNT] = {
+	{ "NONE",    1 },
+	{ "SCALE2X", 2 },
+	{ "EAGLE2X", 2 },
+	{ "SCALE3X", 3 },
+	{ "EAGLE3X", 3 },
+	{ "XBR2X",   2 },
+};
+
+/* [filter][paletted] */
+static struct program filter_progs[GL_SHADER_COUNT][2];
+static struct program copy_prog, copy_pal_prog, crt_prog;
+
+static GLuint pal_tex;
+static GLuint fbo, fbo_tex;
+static int fbo_w, fbo_h;
+static GLint viewport[4];
+
+static const float vertices[] = {
+	-1.0f,  1.0f, // 0    0  1
+	 1.0f,  1.0f, // 1  ^
+	-1.0f, -1.0f, // 2  | 2  3
+	 1.0f, -1.0f, // 3  +-->
+};
+
+static const char vertex_src[] =
+	"attribute vec2 a_pos;\n"
+	"attribute vec2 a_uv;\n"
+	"varying vec2 v_uv;\n"
+	"void main()\n"
+	"{\n"
+	"	gl_Position = vec4(a_pos, 0.0, 1.0);\n"
+	"	v_uv = a_uv;\n"
+	"}\n";
+
+static const char frag_head[] =
+	"#ifdef GL_FRAGMENT_PRECISION_HIGH\n"
+	"precision highp float;\n"
+	"#else\n"
+	"precision mediump float;\n"
+	"#endif\n"
+	"uniform sampler2D u_tex;\n"
+	"uniform sampler2D u_pal;\n"
+	"uniform vec2 u_size;\n"		/* frame */
+	"uniform vec2 u_tex_size;\n"	/* texture, may be larger */
+	"varying vec2 v_uv;\n";
+
+/* px() fetches a frame pixel by integer coordinates, edges clamp */
+static const char frag_filter[] =
+	"vec3 px(vec2 p)\n"
+	"{\n"
+	"	p = clamp(p, vec2(0.0), u_size - 1.0);\n"
+	"	vec4 c = texture2D(u_tex, (p + 0.5) / u_tex_size);\n"
+	"#ifdef PAL\n"
+	"	c = texture2D(u_pal, vec2(c.r * (255.0 / 256.0) + 0.5 / 256.0, 0.5));\n"
+	"#endif\n"
+	"	return c.rgb;\n"
+	"}\n"
+	"#define P(x, y) px(cell + vec2(x, y))\n"
+	"float lum(vec3 c)\n"
+	"{\n"
+	"	return dot(c, vec3(14.352, 28.176, 5.472));\n"
+	"}\n"
+	"void main()\n"
+	"{\n"
+	"	vec2 pos = v_uv * u_tex_size;\n"
+	"	vec2 cell = floor(pos);\n"
+	"	vec2 sub = pos - cell;\n"
+	"	vec3 E = P(0.0, 0.0);\n"
+	"	vec3 o = E;\n"
+	"#if defined(SCALE2X)\n"
+	/* corner on the side of the subpixel, (X, Y) its row/column
+	 * neighbours: takes X if they match, as long as the opposite
+	 * sides differ */
+	"	float dx = sub.x < 0.5 ? -1.0 : 1.0;\n"
+	"	float dy = sub.y < 0.5 ? -1.0 : 1.0;\n"
+	"	vec3 B = P(0.0, -1.0), D = P(-1.0, 0.0);\n"
+	"	vec3 F = P(1.0, 0.0), H = P(0.0, 1.0);\n"
+	"	vec3 X = P(dx, 0.0), Y = P(0.0, dy);\n"
+	"	if (B != H && D != F && X == Y)\n"
+	"		o = X;\n"
+	"#elif defined(EAGLE2X)\n"
+	"	float dx = sub.x < 0.5 ? -1.0 : 1.0;\n"
+	"	float dy = sub.y < 0.5 ? -1.0 : 1.0;\n"
+	"	vec3 S = P(dx, dy), T = P(0.0, dy), V = P(dx, 0.0);\n"
+	"	if (S == T && S == V)\n"
+	"		o = T;\n"
+	"#elif defined(SCALE3X) || defined(EAGLE3X)\n"
+	"	vec2 s = floor(sub * 3.0);\n"
+	"	vec3 A = P(-1.0, -1.0), B = P(0.0, -1.0), C = P(1.0, -1.0);\n"
+	"	vec3 D = P(-1.0,  0.0),                   F = P(1.0,  0.0);\n"
+	"	vec3 G = P(-1.0,  1.0), H = P(0.0,  1.0), I = P(1.0,  1.0);\n"
+	"#if defined(SCALE3X)\n"
+	"	if (B != H && D != F) {\n"
+	"		if (s.y == 0.0) {\n"
+	"			if (s.x == 0.0) { if (D == B) o = D; }\n"
+	"			else if (s.x == 1.0) { if ((D == B && E != C) || (B == F && E != A)) o = B; }\n"
+	"			else { if (B == F) o = F; }\n"
+	"		}\n"
+	"		else if (s.y == 1.0) {\n"
+	"			if (s.x == 0.0) { if ((D == B && E != G) || (D == H && E != A)) o = D; }\n"
+	"			else if (s.x == 2.0) { if ((B == F && E != I) || (H == F && E != C)) o = F; }\n"
+	"		}\n"
+	"		else {\n"
+	"			if (s.x == 0.0) { if (D == H) o = D; }\n"
+	"			else if (s.x == 1.0) { if ((D == H && E != I) || (H == F && E != G)) o = H; }\n"
+	"			else { if (H == F) o = F; }\n"
+	"		}\n"
+	"	}\n"
+	"#else\n"
+	"	bool tl = A == B && A == D, tr = C == B && C == F;\n"
+	"	bool bl = G == H && G == D, br = I == H && I == F;\n"
+	"	if (s.y == 0.0) {\n"
+	"		if (s.x == 0.0) { if (tl) o = B; }\n"
+	"		else if (s.x == 1.0) { if (tl && tr) o = B; }\n"
+	"		else { if (tr) o = B; }\n"
+	"	}\n"
+	"	else if (s.y == 1.0) {\n"
+	"		if (s.x == 0.0) { if (tl && bl) o = D; }\n"
+	"		else if (s.x == 2.0) { if (tr && br) o = F; }\n"
+	"	}\n"
+	"	else {\n"
+	"		if (s.x == 0.0) { if (bl) o = H; }\n"
+	"		else if (s.x == 1.0) { if (bl && br) o = H; }\n"
+	"		else { if (br) o = H; }\n"
+	"	}\n"
+	"#endif\n"
+	"#elif defined(XBR2X)\n"
+	/* xBR level 1 without blending, mirrored so that the subpixel's
+	 * corner is the bottom right one:
+	 *        B  .
+	 *     D  E  F  F4
+	 *     G  H  I  I4
+	 *        H5 I5     C is above F */
+	"	float dx = sub.x < 0.5 ? -1.0 : 1.0;\n"
+	"	float dy = sub.y < 0.5 ? -1.0 : 1.0;\n"
+	"	float e = lum(E);\n"
+	"	vec3 F = P(dx, 0.0), H = P(0.0, dy);\n"
+	"	float b = lum(P(0.0, -dy)), c = lum(P(dx, -dy));\n"
+	"	float d = lum(P(-dx, 0.0)), f = lum(F);\n"
+	"	float g = lum(P(-dx, dy)), h = lum(H), i = lum(P(dx, dy));\n"
+	"	float f4 = lum(P(2.0 * dx, 0.0)), i4 = lum(P(2.0 * dx, dy));\n"
+	"	float h5 = lum(P(0.0, 2.0 * dy)), i5 = lum(P(dx, 2.0 * dy));\n"
+	"	float wd1 = abs(e - c) + abs(e - g) + abs(i - f4) + abs(i - h5)\n"
+	"		+ 4.0 * abs(h - f);\n"
+	"	float wd2 = abs(h - d) + abs(h - i5) + abs(f - i4) + abs(f - b)\n"
+	"		+ 4.0 * abs(e - i);\n"
+	"	if (wd1 < wd2 && E != F && E != H)\n"
+	"		o = abs(e - f) <= abs(e - h) ? F : H;\n"
+	"#endif\n"
+	"	gl_FragColor = vec4(o, 1.0);\n"
+	"}\n";
+
+static const char frag_copy[] =
+	"void main()\n"
+	"{\n"
+	"	vec4 c = texture2D(u_tex, v_uv);\n"
+	"#ifdef PAL\n"
+	"	c = texture2D(u_pal, vec2(c.r * (255.0 / 256.0) + 0.5 / 256.0, 0.5));\n"
+	"#endif\n"
+	"	gl_FragColor = vec4(c.rgb, 1.0);\n"
+	"}\n";
+
+/* scanlines follow the emulated lines, plus an aperture grille on
+ * output pixel columns */
+static const char frag_crt[] =
+	"void main()\n"
+	"{\n"
+	"	vec3 c = texture2D(u_tex, v_uv).rgb;\n"
+	"	float l = fract(v_uv.y * u_tex_size.y);\n"
+	"	float m = mod(floor(gl_FragCoord.x), 3.0);\n"
+	"	vec3 mask = vec3(m == 0.0 ? 1.0 : 0.75, m == 1.0 ? 1.0 : 0.75,\n"
+	"		m == 2.0 ? 1.0 : 0.75);\n"
+	"	c *= mix(0.55, 1.0, sin(l * 3.14159265));\n"
+	"	gl_FragColor = vec4(min(c * mask * 1.35, 1.0), 1.0);\n"
+	"}\n";
+
+const struct gl_funcs gl_shader_funcs = {
+	glGetError,
+	glGetString,
+	glGetIntegerv,
+	glClear,
+	glGenTextures,
+	glBindTexture,
+	glTexParameterf,
+	glPixelStorei,
+	glTexImage2D,
+	glTexSubImage2D,
+	glGenBuffers,
+	glDeleteBuffers,
+	glBindBuffer,
+	glBufferData,
+};
+
+static int gl_shader_have_error(const char *name)
+{
+	GLenum e = glGetError();
+	if (e != GL_NO_ERROR) {
+		fprintf(stderr, "GL error: shader %s %x\n", name, e);
+		return -1;
+	}
+	return 0;
+}
+
+static GLuint compile(GLenum type, const char **src, int count)
+{
+	GLuint shader = glCreateShader(type);
+	GLint ok = 0;
+	char log[512];
+
+	glShaderSource(shader, count, src, NULL);
+	glCompileShader(shader);
+	glGetShaderiv(shader, GL_COMPILE_STATUS, &ok);
+	if (!ok) {
+		glGetShaderInfoLog(shader, sizeof(log), NULL, log);
+		fprintf(stderr, "GL: shader compile failed: %s\n", log);
+		glDeleteShader(shader);
+		return 0;
+	}
+	return shader;
+}
+
+static int program_build(struct program *p, const char *defines,
+	const char *body)
+{
+	const char *fsrc[3] = { defines, frag_head, body };
+	const char *vsrc[1] = { vertex_src };
+	GLuint vs, fs;
+	GLint ok = 0;
+	char log[512];
+
+	vs = compile(GL_VERTEX_SHADER, vsrc, 1);
+	fs = compile(GL_FRAGMENT_SHADER, fsrc, 3);
+	if (vs == 0 || fs == 0) {
+		if (vs != 0)
+			glDeleteShader(vs);
+		if (fs != 0)
+			glDeleteShader(fs);
+		goto fail;
+	}
+
+	p->prog = glCreateProgram();
+	glAttachShader(p->prog, vs);
+	glAttachShader(p->prog, fs);
+	glBindAttribLocation(p->prog, ATTR_POS, "a_pos");
+	glBindAttribLocation(p->prog, ATTR_UV, "a_uv");
+	glLinkProgram(p->prog);
+	glDeleteShader(vs);
+	glDeleteShader(fs);
+
+	glGetProgramiv(p->prog, GL_LINK_STATUS, &ok);
+	if (!ok) {
+		glGetProgramInfoLog(p->prog, sizeof(log), NULL, log);
+		fprintf(stderr, "GL: shader link failed: %s\n", log);
+		glDeleteProgram(p->prog);
+		p->prog = 0;
+		goto fail;
+	}
+
+	p->u_tex = glGetUniformLocation(p->prog, "u_tex");
+	p->u_pal = glGetUniformLocation(p->prog, "u_pal");
+	p->u_size = glGetUniformLocation(p->prog, "u_size");
+	p->u_tex_size = glGetUniformLocation(p->prog, "u_tex_size");
+	glUseProgram(p->prog);
+	glUniform1i(p->u_tex, 0);
+	glUniform1i(p->u_pal, 1);
+	return 0;
+
+fail:
+	p->failed = 1;
+	return -1;
+}
+
+static struct program *filter_prog(int filter, int pal8)
+{
+	struct program *p = &filter_progs[filter][pal8];
+	char defines[64];
+
+	if (p->prog == 0 && !p->failed) {
+		snprintf(defines, sizeof(defines), "#define %s\n%s",
+			filters[filter].define, pal8 ? "#define PAL\n" : "");
+		program_build(p, defines, frag_filter);
+	}
+	return p->prog != 0 ? p : NULL;
+}
+
+int gl_shader_init(void)
+{
+	memset(filter_progs, 0, sizeof(filter_progs));
+	memset(&copy_prog, 0, sizeof(copy_prog));
+	memset(&copy_pal_prog, 0, sizeof(copy_pal_prog));
+	memset(&crt_prog, 0, sizeof(crt_prog));
+	fbo = fbo_tex = pal_tex = 0;
+	fbo_w = fbo_h = 0;
+
+	if (program_build(&copy_prog, "", frag_copy) != 0)
+		return -1;
+	if (program_build(&copy_pal_prog, "#define PAL\n", frag_copy) != 0)
+		return -1;
+
+	glGetIntegerv(GL_VIEWPORT, viewport);
+
+	glGenTextures(1, &pal_tex);
+	glBindTexture(GL_TEXTURE_2D, pal_tex);
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+	glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA, 256, 1, 0, GL_RGBA,
+		GL_UNSIGNED_BYTE, NULL);
+
+	glGenFramebuffers(1, &fbo);
+	glGenTextures(1, &fbo_tex);
+
+	glEnableVertexAttribArray(ATTR_POS);
+	glEnableVertexAttribArray(ATTR_UV);
+	glDisable(GL_CULL_FACE);
+	glDisable(GL_DEPTH_TEST);
+
+	return gl_shader_have_error("init");
+}
+
+void gl_shader_finish(void)
+{
+	int i, j;
+
+	for (i = 0; i < GL_SHADER_COUNT; i++)
+		for (j = 0; j < 2; j++)
+			if (filter_progs[i][j].prog != 0)
+				glDeleteProgram(filter_progs[i][j].prog);
+	if (copy_prog.prog != 0)
+		glDeleteProgram(copy_prog.prog);
+	if (copy_pal_prog.prog != 0)
+		glDeleteProgram(copy_pal_prog.prog);
+	if (crt_prog.prog != 0)
+		glDeleteProgram(crt_prog.prog);
+	memset(filter_progs, 0, sizeof(filter_progs));
+	memset(&copy_prog, 0, sizeof(copy_prog));
+	memset(&copy_pal_prog, 0, sizeof(copy_pal_prog));
+	memset(&crt_prog, 0, sizeof(crt_prog));
+
+	glDeleteFramebuffers(1, &fbo);
+	glDeleteTextures(1, &fbo_tex);
+	glDeleteTextures(1, &pal_tex);
+	fbo = fbo_tex = pal_tex = 0;
+}
+
+void gl_shader_set_palette(const uint32_t *pal, unsigned int format)
+{
+	// recreated in case format changed, it's tiny anyway
+	glActiveTexture(GL_TEXTURE1);
+	glBindTexture(GL_TEXTURE_2D, pal_tex);
+	glTexImage2D(GL_TEXTURE_2D, 0, format, 256, 1, 0, format,
+		GL_UNSIGNED_BYTE, pal);
+	glActiveTexture(GL_TEXTURE0);
+}
+
+static int fbo_setup(int w, int h)
+{
+	if (w == fbo_w && h == fbo_h)
+		return 0;
+
+	glBindTexture(GL_TEXTURE_2D, fbo_tex);
+	glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA, w, h, 0, GL_RGBA,
+		GL_UNSIGNED_BYTE, NULL);
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+
+	glBindFramebuffer(GL_FRAMEBUFFER, fbo);
+	glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0,
+		GL_TEXTURE_2D, fbo_tex, 0);
+	if (glCheckFramebufferStatus(GL_FRAMEBUFFER) != GL_FRAMEBUFFER_COMPLETE) {
+		fprintf(stderr, "GL: %dx%d FBO incomplete\n", w, h);
+		glBindFramebuffer(GL_FRAMEBUFFER, 0);
+		fbo_w = fbo_h = 0;
+		return -1;
+	}
+	glBindFramebuffer(GL_FRAMEBUFFER, 0);
+
+	fbo_w = w;
+	fbo_h = h;
+	return 0;
+}
+
+static void tex_filter(GLuint name, GLint filter)
+{
+	glBindTexture(GL_TEXTURE_2D, name);
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, filter);
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, filter);
+}
+
+static void draw_quad(const struct program *p, const float *texcoords,
+	int w, int h, int tex_w, int tex_h)
+{
+	glUseProgram(p->prog);
+	if (p->u_size >= 0)
+		glUniform2f(p->u_size, w, h);
+	if (p->u_tex_size >= 0)
+		glUniform2f(p->u_tex_size, tex_w, tex_h);
+	glVertexAttribPointer(ATTR_POS, 2, GL_FLOAT, GL_FALSE, 0, vertices);
+	glVertexAttribPointer(ATTR_UV, 2, GL_FLOAT, GL_FALSE, 0, texcoords);
+	glDrawArrays(GL_TRIANGLE_STRIP, 0, 4);
+}
+
+int gl_shader_draw(unsigned int tex, int w, int h, int tex_w, int tex_h,
+	int pal8, int shader)
+{
+	int filter = shader & ~GL_SHADER_CRT;
+	const struct program *p = &copy_prog;
+	float u = (float)w / tex_w, v = (float)h / tex_h;
+	// the screen shows row 0 on top, the FBO gets it at the bottom
+	float tc_screen[8] = { 0.0f, 0.0f, u, 0.0f, 0.0f, v, u, v };
+	float tc_fbo[8] = { 0.0f, v, u, v, 0.0f, 0.0f, u, 0.0f };
+	static const float tc_screen_fbo[8] = { 0, 0, 1, 0, 0, 1, 1, 1 };
+
+	if (filter < 0 || filter >= GL_SHADER_COUNT)
+		filter = GL_SHADER_NONE;
+
+	if (shader & GL_SHADER_CRT) {
+		if (crt_prog.prog == 0 && !crt_prog.failed)
+			program_build(&crt_prog, "", frag_crt);
+		if (crt_prog.prog != 0)
+			p = &crt_prog;
+	}
+
+	if (filter != GL_SHADER_NONE || pal8) {
+		int scale = filters[filter].scale;
+		struct program *fp = filter_prog(filter, pal8);
+
+		// fall back to no filter if it doesn't build
+		if (fp == NULL && filter != GL_SHADER_NONE) {
+			scale = 1;
+			fp = pal8 ? filter_prog(GL_SHADER_NONE, pal8) : NULL;
+		}
+		if (fp != NULL && fbo_setup(w * scale, h * scale) == 0) {
+			tex_filter(tex, GL_NEAREST);
+			glBindFramebuffer(GL_FRAMEBUFFER, fbo);
+			glViewport(0, 0, fbo_w, fbo_h);
+			draw_quad(fp, tc_fbo, w, h, tex_w, tex_h);
+			glBindFramebuffer(GL_FRAMEBUFFER, 0);
+			glViewport(viewport[0], viewport[1],
+				viewport[2], viewport[3]);
+
+			// the FBO is exactly the filtered frame
+			tex_filter(fbo_tex, GL_LINEAR);
+			draw_quad(p, tc_screen_fbo, w, h, w, h);
+			goto out;
+		}
+	}
+
+	if (pal8) {
+		// palette lookup straight to the screen, indexes can't be
+		// interpolated and the CRT pass has no palette
+		tex_filter(tex, GL_NEAREST);
+		draw_quad(&copy_pal_prog, tc_screen, w, h, tex_w, tex_h);
+		goto out;
+	}
+
+	tex_filter(tex, GL_LINEAR);
+	draw_quad(p, tc_screen, w, h, tex_w, tex_h);
+
+out:
+	glBindTexture(GL_TEXTURE_2D, tex);
+	return gl_shader_have_error("draw");
+}
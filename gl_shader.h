@@ -0,0 +1,42 @@
+/* GLES2 drawing, used by gl.c when built with HAVE_GLES2 */
+
+/*
+ * The calls gl.c makes with either context. libGLESv1_CM and libGLESv2
+ * both export them, but each only has to work with its own context
+ * kind, so gl.c calls the GLES1 ones through this too.
+ */
+struct gl_funcs {
+	GLenum (GL_APIENTRY *glGetError)(void);
+	const GLubyte *(GL_APIENTRY *glGetString)(GLenum name);
+	void (GL_APIENTRY *glGetIntegerv)(GLenum pname, GLint *params);
+	void (GL_APIENTRY *glClear)(GLbitfield mask);
+	void (GL_APIENTRY *glGenTextures)(GLsizei n, GLuint *textures);
+	void (GL_APIENTRY *glBindTexture)(GLenum target, GLuint texture);
+	void (GL_APIENTRY *glTexParameterf)(GLenum target, GLenum pname,
+		GLfloat param);
+	void (GL_APIENTRY *glPixelStorei)(GLenum pname, GLint param);
+	void (GL_APIENTRY *glTexImage2D)(GLenum target, GLint level,
+		GLint internalformat, GLsizei width, GLsizei height,
+		GLint border, GLenum format, GLenum type, const void *pixels);
+	void (GL_APIENTRY *glTexSubImage2D)(GLenum target, GLint level,
+		GLint xoffset, GLint yoffset, GLsizei width, GLsizei height,
+		GLenum format, GLenum type, const void *pixels);
+	void (GL_APIENTRY *glGenBuffers)(GLsizei n, GLuint *buffers);
+	void (GL_APIENTRY *glDeleteBuffers)(GLsizei n, const GLuint *buffers);
+	void (GL_APIENTRY *glBindBuffer)(GLenum target, GLuint buffer);
+	void (GL_APIENTRY *glBufferData)(GLenum target, GLsizeiptr size,
+		const void *data, GLenum usage);
+};
+
+/* the libGLESv2 ones */
+extern const struct gl_funcs gl_shader_funcs;
+
+int gl_shader_init(void);
+void gl_shader_finish(void);
+
+/* pal is 256 entries in texture byte order, format GL_RGBA or GL_BGRA_EXT */
+void gl_shader_set_palette(const uint32_t *pal, unsigned int format);
+
+/* draws the w x h frame from the top left of the tex_w x tex_h texture */
+int gl_shader_draw(unsigned int tex, int w, int h, int tex_w, int tex_h,
+	int pal8, int shader);
@@ -32,6 +32,7 @@
 #include "soc.h"
 #include "plat_gp2x.h"
 #include "../plat.h"
+#include "../pixops.h"
 
 volatile unsigned short *memregs;
 volatile unsigned int   *memregl;
@@ -641,6 +642,8 @@ int plat_target_init(void)
 	if (mixerdev == -1)
 		perror("open(/dev/mixer)");
 
+	pixops_init();
+
 	return 0;
 }
 
@@ -0,0 +1,336 @@
+/*
+ * input recording and replay
+ *
+ * This work is licensed under the terms of any of these licenses
+ * (at your option):
+ *  - GNU GPL, version 2 or later.
+ *  - GNU LGPL, version 2.1 or later.
+ *  - MAME license.
+ * See the COPYING file in the top-level directory.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+
+#include "input.h"
+#include "lprintf.h"
+#include "in_replay.h"
+
+#define IN_REPLAY_PREFIX "replay:"
+#define IN_REC_VERSION 1
+
+/*
+ * file: header, then records in frame order, native byte order;
+ * IN_REC_FRAME is followed by 'keycode' words of in_update() result.
+ * Everything is 32bit aligned at most, records are read in place.
+ */
+struct in_rec_hdr {
+	char magic[4];
+	uint16_t version;
+	uint16_t bindtypes;	/* IN_BINDTYPE_COUNT of the recorder */
+};
+
+enum {
+	IN_REC_FRAME = 1,
+	IN_REC_KEY,
+	IN_REC_END,
+};
+
+struct in_rec {
+	uint32_t frame;		/* in_update() calls before this */
+	uint32_t reserved;	/* 0, replay only goes by frame */
+	uint16_t type;		/* IN_REC_* */
+	uint16_t keycode;
+	uint8_t  is_down;
+	uint8_t  charcode;
+	uint16_t menu;		/* menu_translate() result */
+};
+
+static const char in_rec_magic[4] = { 'P', 'I', 'R', 'C' };
+
+static struct {
+	FILE *f;
+	uint32_t frame;
+	int last[IN_BINDTYPE_COUNT];
+} rec;
+
+static struct {
+	char *data;
+	size_t size;
+	size_t fpos, kpos;	/* frame and key record cursors */
+	uint32_t frame;
+	uint32_t frames;
+	int key_count;
+	int cur[IN_BINDTYPE_COUNT];
+	int last_kc, last_menu;	/* for menu_translate */
+	char last_char;
+	char name[64];
+} rp;
+
+static void rec_write(int type, int keycode, int is_down, int menu,
+	int charcode, const int *words)
+{
+	struct in_rec r;
+	uint32_t w[IN_BINDTYPE_COUNT];
+	int i, ok;
+
+	memset(&r, 0, sizeof(r));
+	r.frame = rec.frame;
+	r.type = type;
+	r.keycode = keycode;
+	r.is_down = is_down;
+	r.charcode = charcode;
+	r.menu = menu;
+
+	ok = fwrite(&r, sizeof(r), 1, rec.f) == 1;
+	if (ok && words != NULL) {
+		for (i = 0; i < IN_BINDTYPE_COUNT; i++)
+			w[i] = words[i];
+		ok = fwrite(w, sizeof(w), 1, rec.f) == 1;
+	}
+	if (!ok) {
+		lprintf("in_replay: write failed, recording stopped\n");
+		in_set_recorder(NULL, NULL);
+		fclose(rec.f);
+		rec.f = NULL;
+	}
+}
+
+static void rec_frame(const int *result)
+{
+	if (memcmp(result, rec.last, sizeof(rec.last)) != 0) {
+		memcpy(rec.last, result, sizeof(rec.last));
+		rec_write(IN_REC_FRAME, IN_BINDTYPE_COUNT, 0, 0, 0, result);
+	}
+	rec.frame++;
+}
+
+static void rec_key(int keycode, int is_down, int menu, int charcode)
+{
+	if ((unsigned int)keycode > 0xffff)
+		return;
+	rec_write(IN_REC_KEY, keycode, is_down, menu, charcode, NULL);
+}
+
+int in_record_start(const char *fname)
+{
+	struct in_rec_hdr hdr;
+
+	in_record_stop();
+
+	rec.f = fopen(fname, "wb");
+	if (rec.f == NULL) {
+		lprintf("in_replay: can't create %s\n", fname);
+		return -1;
+	}
+
+	memcpy(hdr.magic, in_rec_magic, sizeof(hdr.magic));
+	hdr.version = IN_REC_VERSION;
+	hdr.bindtypes = IN_BINDTYPE_COUNT;
+	if (fwrite(&hdr, sizeof(hdr), 1, rec.f) != 1) {
+		lprintf("in_replay: write failed\n");
+		fclose(rec.f);
+		rec.f = NULL;
+		return -1;
+	}
+
+	rec.frame = 0;
+	memset(rec.last, 0, sizeof(rec.last));
+	in_set_recorder(rec_frame, rec_key);
+
+	return 0;
+}
+
+void in_record_stop(void)
+{
+	if (rec.f == NULL)
+		return;
+
+	in_set_recorder(NULL, NULL);
+	rec_write(IN_REC_END, 0, 0, 0, 0, NULL);
+	if (rec.f != NULL) {
+		fclose(rec.f);
+		rec.f = NULL;
+	}
+	lprintf("in_replay: recorded %u frames\n", rec.frame);
+}
+
+static const struct in_rec *rp_rec(size_t pos)
+{
+	return (const struct in_rec *)(rp.data + pos);
+}
+
+static size_t rp_next(size_t pos)
+{
+	const struct in_rec *r = rp_rec(pos);
+
+	pos += sizeof(*r);
+	if (r->type == IN_REC_FRAME)
+		pos += r->keycode * sizeof(uint32_t);
+	return pos;
+}
+
+/* check the records, find the length and the highest keycode */
+static int rp_scan(void)
+{
+	const struct in_rec_hdr *hdr = (const void *)rp.data;
+	const struct in_rec *r = NULL;
+	size_t pos, next;
+
+	if (rp.size < sizeof(*hdr) || memcmp(hdr->magic, in_rec_magic, 4) != 0
+	    || hdr->version != IN_REC_VERSION
+	    || hdr->bindtypes != IN_BINDTYPE_COUNT)
+		return -1;
+
+	rp.key_count = 1;
+	rp.frames = 0;
+	for (pos = sizeof(*hdr); pos + sizeof(*r) <= rp.size; pos = next) {
+		r = rp_rec(pos);
+		next = rp_next(pos);
+		if (next > rp.size)
+			break;
+		if (r->type == IN_REC_FRAME && r->keycode != IN_BINDTYPE_COUNT)
+			break;
+		if (r->type == IN_REC_KEY && r->keycode >= rp.key_count)
+			rp.key_count = r->keycode + 1;
+		if (r->type == IN_REC_END) {
+			rp.frames = r->frame;
+			break;
+		}
+		rp.frames = r->frame + 1;
+	}
+	if (pos + sizeof(*r) > rp.size || r->type != IN_REC_END)
+		lprintf("in_replay: truncated recording\n");
+
+	/* don't walk into a damaged tail */
+	rp.size = pos;
+	return 0;
+}
+
+static void in_replay_probe(void)
+{
+	if (rp.data != NULL)
+		in_register(rp.name, -1, &rp, rp.key_count, NULL, 0);
+}
+
+static int in_replay_update(void *drv_data, const int *binds, int *result)
+{
+	const struct in_rec *r;
+	const uint32_t *w;
+	int i;
+
+	for (; rp.fpos < rp.size; rp.fpos = rp_next(rp.fpos)) {
+		r = rp_rec(rp.fpos);
+		if (r->frame > rp.frame)
+			break;
+		if (r->type != IN_REC_FRAME)
+			continue;
+		w = (const uint32_t *)(r + 1);
+		for (i = 0; i < IN_BINDTYPE_COUNT; i++)
+			rp.cur[i] = w[i];
+	}
+
+	/* binds were applied when recording */
+	for (i = 0; i < IN_BINDTYPE_COUNT; i++)
+		result[i] |= rp.cur[i];
+	rp.frame++;
+
+	return 0;
+}
+
+static int in_replay_update_keycode(void *drv_data, int *is_down)
+{
+	const struct in_rec *r;
+
+	for (; rp.kpos < rp.size; rp.kpos = rp_next(rp.kpos)) {
+		r = rp_rec(rp.kpos);
+		if (r->frame > rp.frame)
+			break;
+		if (r->type != IN_REC_KEY)
+			continue;
+
+		rp.kpos = rp_next(rp.kpos);
+		rp.last_kc = r->keycode;
+		rp.last_menu = r->menu;
+		rp.last_char = r->charcode;
+		if (is_down != NULL)
+			*is_down = r->is_down;
+		return r->keycode;
+	}
+
+	return -1;
+}
+
+/* gives back what the recorded device translated to */
+static int in_replay_menu_translate(void *drv_data, int keycode, char *charcode)
+{
+	if (keycode < 0 || keycode != rp.last_kc)
+		return 0;
+
+	if (charcode != NULL && (rp.last_menu & PBTN_CHAR))
+		*charcode = rp.last_char;
+	return rp.last_menu;
+}
+
+static const in_drv_t in_replay_drv = {
+	.prefix         = IN_REPLAY_PREFIX,
+	.probe          = in_replay_probe,
+	.update         = in_replay_update,
+	.update_keycode = in_replay_update_keycode,
+	.menu_translate = in_replay_menu_translate,
+};
+
+int in_replay_init(const char *fname)
+{
+	const char *base;
+	long size;
+	FILE *f;
+
+	f = fopen(fname, "rb");
+	if (f == NULL) {
+		lprintf("in_replay: can't open %s\n", fname);
+		return -1;
+	}
+	fseek(f, 0, SEEK_END);
+	size = ftell(f);
+	fseek(f, 0, SEEK_SET);
+
+	free(rp.data);
+	memset(&rp, 0, sizeof(rp));
+	rp.data = malloc(size > 0 ? size : 1);
+	if (rp.data == NULL || size < 0 || fread(rp.data, 1, size, f) != (size_t)size) {
+		lprintf("in_replay: can't read %s\n", fname);
+		goto fail;
+	}
+	fclose(f);
+	f = NULL;
+
+	rp.size = size;
+	if (rp_scan() != 0) {
+		lprintf("in_replay: %s is not a recording\n", fname);
+		goto fail;
+	}
+	rp.fpos = rp.kpos = sizeof(struct in_rec_hdr);
+	rp.last_kc = -1;
+
+	base = strrchr(fname, '/');
+	base = base != NULL ? base + 1 : fname;
+	snprintf(rp.name, sizeof(rp.name), IN_REPLAY_PREFIX "%s", base);
+	lprintf("in_replay: %s, %u frames\n", fname, rp.frames);
+
+	return in_register_driver(&in_replay_drv, NULL);
+
+fail:
+	if (f != NULL)
+		fclose(f);
+	free(rp.data);
+	rp.data = NULL;
+	return -1;
+}
+
+int in_replay_finished(void)
+{
+	return rp.data != NULL && rp.frame >= rp.frames;
+}
@@ -0,0 +1,17 @@
+/*
+ * Input recording for repeatable (benchmark) runs: in_update() results
+ * are stored per frame, only when they change, and in_update_keycode()
+ * events with the frame they happened on. On replay the "replay:"
+ * device gives the same results back at the same frame indices,
+ * counting frames by in_update() calls; binds are not applied again.
+ */
+
+/* record until in_record_stop(), returns -1 on error */
+int  in_record_start(const char *fname);
+void in_record_stop(void);
+
+/* load a recording and register its driver, call before in_probe();
+ * for headless runs register it instead of the real drivers */
+int  in_replay_init(const char *fname);
+/* all recorded frames have been played back */
+int  in_replay_finished(void);
@@ -10,13 +10,15 @@
  */
 
 #include <stdio.h>
+#include <string.h>
 #include <SDL.h>
+#include <SDL_syswm.h>
 #include "input.h"
 #include "in_sdl.h"
 
 #define IN_SDL_PREFIX "sdl:"
-/* should be machine word for best performace */
-typedef unsigned long keybits_t;
+/* same word as input.c keybits, so update_keybits is a copy */
+typedef uint32_t keybits_t;
 #define KEYBITS_WORD_BITS (sizeof(keybits_t) * 8)
 
 struct in_sdl_state {
@@ -348,27 +350,16 @@ out:
 	return retval;
 }
 
-static int in_sdl_update(void *drv_data, const int *binds, int *result)
+static int in_sdl_update_keybits(void *drv_data, uint32_t *keybits, int words)
 {
 	struct in_sdl_state *state = drv_data;
-	keybits_t mask;
-	int i, sym, bit, b;
+	int n = sizeof(state->keystate) / sizeof(state->keystate[0]);
 
 	collect_events(state, NULL, NULL);
 
-	for (i = 0; i < SDLK_LAST / KEYBITS_WORD_BITS + 1; i++) {
-		mask = state->keystate[i];
-		if (mask == 0)
-			continue;
-		for (bit = 0; mask != 0; bit++, mask >>= 1) {
-			if ((mask & 1) == 0)
-				continue;
-			sym = i * KEYBITS_WORD_BITS + bit;
-
-			for (b = 0; b < IN_BINDTYPE_COUNT; b++)
-				result[b] |= binds[IN_BIND_OFFS(sym, b)];
-		}
-	}
+	if (n > words)
+		n = words;
+	memcpy(keybits, state->keystate, n * sizeof(keybits[0]));
 
 	return 0;
 }
@@ -386,6 +377,25 @@ static int in_sdl_update_keycode(void *drv_data, int *is_down)
 	return ret_kc;
 }
 
+/* SDL 1.2 can't block with a timeout, but under X events arrive
+ * through the display connection, so that can be waited on.
+ * Joysticks are only read by SDL_PumpEvents, those stay polled. */
+static int in_sdl_get_wakeup_fd(void *drv_data)
+{
+#ifdef SDL_VIDEO_DRIVER_X11
+	struct in_sdl_state *state = drv_data;
+	SDL_SysWMinfo info;
+
+	if (state->joy != NULL)
+		return -1;
+
+	SDL_VERSION(&info.version);
+	if (SDL_GetWMInfo(&info) > 0 && info.subsystem == SDL_SYSWM_X11)
+		return ConnectionNumber(info.info.x11.display);
+#endif
+	return -1;
+}
+
 struct menu_keymap {
 	short key;
 	short pbtn;
@@ -466,9 +476,10 @@ static const in_drv_t in_sdl_drv = {
 	.probe          = in_sdl_probe,
 	.free           = in_sdl_free,
 	.get_key_names  = in_sdl_get_key_names,
-	.update         = in_sdl_update,
+	.update_keybits = in_sdl_update_keybits,
 	.update_keycode = in_sdl_update_keycode,
 	.menu_translate = in_sdl_menu_translate,
+	.get_wakeup_fd  = in_sdl_get_wakeup_fd,
 };
 
 void in_sdl_init(const struct in_default_bind *defbinds,
@@ -12,6 +12,7 @@
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
+#include <pthread.h>
 
 #include "input.h"
 #include "plat.h"
@@ -22,6 +23,21 @@
 #include "../win32/in_vk.h"
 #endif
 
+/* binds compiled down to the bound keys, so that per frame cost
+ * depends on bound and pressed keys only */
+struct in_bind_entry {
+	int keycode;
+	int binds[IN_BINDTYPE_COUNT];
+};
+
+struct in_bind_table {
+	int w_first, w_last;		/* keybits words that have bound keys */
+	uint32_t *bound;		/* bitmap of bound keys */
+	unsigned short *index;		/* keycode -> e[] */
+	int count;
+	struct in_bind_entry e[];
+};
+
 typedef struct
 {
 	int drv_id;
@@ -30,6 +46,7 @@ typedef struct
 	char *name;
 	int key_count;
 	int *binds;	/* total = key_count * bindtypes * 2 */
+	struct in_bind_table *btab; /* NULL when binds changed */
 	const char * const *key_names;
 	unsigned int probed:1;
 	unsigned int does_combos:1;
@@ -44,6 +61,35 @@ static int in_probe_dev_id;
 static int menu_key_state = 0;
 static int menu_last_used_dev = 0;
 
+/* fds of probed devices, rebuilt when devices change */
+static struct plat_wait_set *in_wait_set;
+static int in_wait_set_dirty = 1;
+static int in_have_polled_devs;		/* async devs without a wakeup fd */
+
+/* recorder hooks (in_replay.c), NULL when not recording */
+static void (*in_rec_frame)(const int *result);
+static void (*in_rec_key)(int keycode, int is_down, int menu, int charcode);
+
+/* input thread, one single producer/single consumer queue per device */
+#define IN_EVQ_SIZE 64	/* power of 2 */
+struct in_evq {
+	struct in_event ev[IN_EVQ_SIZE];
+	volatile unsigned int head;	/* written by the thread only */
+	volatile unsigned int tail;	/* written by the consumer only */
+	unsigned int dropped;
+	unsigned int *keys;		/* consumer's key state bitmap */
+	int active;
+};
+static struct in_evq in_evqs[IN_MAX_DEVS];
+static struct plat_wait_set *in_thread_ws;
+static pthread_t in_thread;
+static volatile int in_thread_quit;
+static volatile int in_thread_hotplug;	/* a hotplug fd fired */
+static int in_thread_running;
+/* held by the thread while it services devices, and by hotplug
+ * while it changes the device list under it */
+static pthread_mutex_t in_thread_mutex = PTHREAD_MUTEX_INITIALIZER;
+
 #define DRV(id) in_drivers[id]
 
 
@@ -74,12 +120,101 @@ static int *in_alloc_binds(int drv_id, int key_count)
 	return binds;
 }
 
+static void in_bind_table_free(struct in_bind_table *t)
+{
+	if (t == NULL)
+		return;
+	free(t->bound);
+	free(t->index);
+	free(t);
+}
+
+/* to be called whenever dev->binds is written or replaced */
+static void in_binds_changed(in_dev_t *dev)
+{
+	in_bind_table_free(dev->btab);
+	dev->btab = NULL;
+}
+
+static struct in_bind_table *in_bind_table_build(const in_dev_t *dev)
+{
+	int words = (dev->key_count + 31) / 32;
+	struct in_bind_table *t;
+	int k, b, n, count = 0;
+
+	for (k = 0; k < dev->key_count; k++)
+		for (b = 0; b < IN_BINDTYPE_COUNT; b++)
+			if (dev->binds[IN_BIND_OFFS(k, b)]) {
+				count++;
+				break;
+			}
+
+	t = calloc(1, sizeof(*t) + count * sizeof(t->e[0]));
+	if (t == NULL)
+		return NULL;
+	t->bound = calloc(words, sizeof(t->bound[0]));
+	t->index = calloc(dev->key_count, sizeof(t->index[0]));
+	if (t->bound == NULL || t->index == NULL) {
+		in_bind_table_free(t);
+		return NULL;
+	}
+
+	t->w_first = words;
+	t->w_last = -1;
+	for (k = n = 0; k < dev->key_count && n < count; k++) {
+		for (b = 0; b < IN_BINDTYPE_COUNT; b++)
+			if (dev->binds[IN_BIND_OFFS(k, b)])
+				break;
+		if (b == IN_BINDTYPE_COUNT)
+			continue;
+
+		t->e[n].keycode = k;
+		for (b = 0; b < IN_BINDTYPE_COUNT; b++)
+			t->e[n].binds[b] = dev->binds[IN_BIND_OFFS(k, b)];
+		t->index[k] = n++;
+		t->bound[k / 32] |= 1u << (k & 31);
+		if (k / 32 < t->w_first)
+			t->w_first = k / 32;
+		t->w_last = k / 32;
+	}
+	t->count = n;
+
+	return t;
+}
+
+static void in_bind_table_apply(const struct in_bind_table *t,
+	const uint32_t *keybits, int *result)
+{
+	const struct in_bind_entry *e;
+	uint32_t mask;
+	int w, b;
+
+	for (w = t->w_first; w <= t->w_last; w++) {
+		mask = keybits[w] & t->bound[w];
+		while (mask != 0) {
+			e = &t->e[t->index[w * 32 + __builtin_ctz(mask)]];
+			mask &= mask - 1;
+			for (b = 0; b < IN_BINDTYPE_COUNT; b++)
+				result[b] |= e->binds[b];
+		}
+	}
+}
+
+/* compiled on first use after a binds change */
+static const struct in_bind_table *in_get_bind_table(in_dev_t *dev)
+{
+	if (dev->btab == NULL)
+		dev->btab = in_bind_table_build(dev);
+	return dev->btab;
+}
+
 static void in_unprobe(in_dev_t *dev)
 {
 	if (dev->probed)
 		DRV(dev->drv_id).free(dev->drv_data);
 	dev->probed = 0;
 	dev->drv_data = NULL;
+	in_wait_set_dirty = 1;
 }
 
 static void in_free(in_dev_t *dev)
@@ -89,11 +224,14 @@ static void in_free(in_dev_t *dev)
 	dev->name = NULL;
 	free(dev->binds);
 	dev->binds = NULL;
+	in_binds_changed(dev);
 }
 
-/* to be called by drivers
- * async devices must set drv_fd_hnd to -1 */
-void in_register(const char *nname, int drv_fd_hnd, void *drv_data,
+static int  in_thread_add_dev(int i);
+static void in_thread_remove_dev(int i);
+
+/* returns the device index, -1 if it couldn't be added */
+static int in_register_dev(const char *nname, int drv_fd_hnd, void *drv_data,
 		int key_count, const char * const *key_names, int combos)
 {
 	int i, ret, dupe_count = 0, *binds;
@@ -125,19 +263,19 @@ void in_register(const char *nname, int drv_fd_hnd, void *drv_data,
 			if (!in_devices[i].probed) break;
 		if (i >= IN_MAX_DEVS) {
 			lprintf("input: too many devices, can't add %s\n", name);
-			return;
+			return -1;
 		}
 		in_free(&in_devices[i]);
 	}
 
 	tmp = strdup(name);
 	if (tmp == NULL)
-		return;
+		return -1;
 
 	binds = in_alloc_binds(in_probe_dev_id, key_count);
 	if (binds == NULL) {
 		free(tmp);
-		return;
+		return -1;
 	}
 
 	in_devices[i].name = tmp;
@@ -153,6 +291,7 @@ update:
 	in_devices[i].drv_id = in_probe_dev_id;
 	in_devices[i].drv_fd_hnd = drv_fd_hnd;
 	in_devices[i].key_names = key_names;
+	in_wait_set_dirty = 1;
 	in_devices[i].drv_data = drv_data;
 
 	if (in_devices[i].binds != NULL) {
@@ -164,6 +303,25 @@ update:
 			in_devices[i].binds = NULL;
 		}
 	}
+	in_binds_changed(&in_devices[i]);
+	return i;
+}
+
+/* to be called by drivers
+ * async devices must set drv_fd_hnd to -1 */
+void in_register(const char *nname, int drv_fd_hnd, void *drv_data,
+		int key_count, const char * const *key_names, int combos)
+{
+	int i;
+
+	/* on hotplug the thread keeps running, only the new device
+	 * is added to it */
+	pthread_mutex_lock(&in_thread_mutex);
+	i = in_register_dev(nname, drv_fd_hnd, drv_data, key_count,
+		key_names, combos);
+	if (i >= 0 && in_thread_running)
+		in_thread_add_dev(i);
+	pthread_mutex_unlock(&in_thread_mutex);
 }
 
 /* key combo handling, to be called by drivers that support it.
@@ -233,10 +391,68 @@ int in_combos_do(int keys, const int *binds, int last_key, int combo_keys, int c
 	return ret;
 }
 
-void in_probe(void)
+void in_unregister(void *drv_data)
 {
 	int i;
 
+	pthread_mutex_lock(&in_thread_mutex);
+	for (i = 0; i < in_dev_count; i++) {
+		in_dev_t *dev = &in_devices[i];
+		if (dev->probed && dev->drv_data == drv_data) {
+			in_thread_remove_dev(i);
+			lprintf("input: \"%s\" removed\n", dev->name);
+			in_unprobe(dev);
+			break;
+		}
+	}
+	pthread_mutex_unlock(&in_thread_mutex);
+}
+
+/* let drivers add/remove devices without a full in_probe() */
+static void in_hotplug(void)
+{
+	int i;
+
+	for (i = 0; i < in_driver_count; i++) {
+		if (in_drivers[i].hotplug == NULL)
+			continue;
+		in_probe_dev_id = i;
+		in_drivers[i].hotplug();
+	}
+}
+
+static void in_thread_hotplug_fds(int add);
+
+/* once per frame. The thread watches the hotplug fds and flags them,
+ * without it only look every 250ms instead of a read each frame */
+static void in_hotplug_frame(void)
+{
+	static uint64_t next_ns;
+	uint64_t now;
+
+	if (in_thread_running) {
+		if (!in_thread_hotplug)
+			return;
+		in_thread_hotplug = 0;
+		in_hotplug();
+		in_thread_hotplug_fds(1);
+		return;
+	}
+
+	now = plat_get_ticks_ns();
+	if (now < next_ns)
+		return;
+	next_ns = now + 250000000;
+	in_hotplug();
+}
+
+void in_probe(void)
+{
+	int i, restart = in_thread_running;
+
+	/* the thread's device list is about to change */
+	in_thread_stop();
+
 	in_have_async_devs = 0;
 	menu_key_state = 0;
 	menu_last_used_dev = 0;
@@ -270,19 +486,338 @@ void in_probe(void)
 		lprintf("input: async-only devices detected..\n");
 
 	in_debug_dump();
+
+	if (restart)
+		in_thread_start();
+}
+
+static int in_update_dev(in_dev_t *dev, int *result)
+{
+	uint32_t keybits[(dev->key_count + 31) / 32];
+	const struct in_bind_table *t;
+	int ret;
+
+	if (DRV(dev->drv_id).update_keybits == NULL)
+		return DRV(dev->drv_id).update(dev->drv_data, dev->binds, result);
+
+	memset(keybits, 0, sizeof(keybits));
+	ret = DRV(dev->drv_id).update_keybits(dev->drv_data,
+		keybits, sizeof(keybits) / sizeof(keybits[0]));
+
+	t = in_get_bind_table(dev);
+	if (ret == 0 && t != NULL)
+		in_bind_table_apply(t, keybits, result);
+
+	return ret;
+}
+
+/* record what the devices produced this frame, then pass it on */
+static void in_update_done(const int *res, int *result)
+{
+	int i;
+
+	if (in_rec_frame != NULL)
+		in_rec_frame(res);
+	for (i = 0; i < IN_BINDTYPE_COUNT; i++)
+		result[i] |= res[i];
 }
 
 /* async update */
 int in_update(int *result)
 {
+	int res[IN_BINDTYPE_COUNT] = { 0, };
 	int i, ret = 0;
 
+	/* the thread owns the fd devices, reading them here would take
+	 * events from it; serve everything queued so far instead */
+	if (in_thread_running)
+		return in_update_at((uint64_t)-1, result);
+
+	in_hotplug_frame();
+
 	for (i = 0; i < in_dev_count; i++) {
 		in_dev_t *dev = &in_devices[i];
 		if (dev->probed && dev->binds != NULL)
-			ret |= DRV(dev->drv_id).update(dev->drv_data, dev->binds, result);
+			ret |= in_update_dev(dev, res);
+	}
+
+	in_update_done(res, result);
+	return ret;
+}
+
+static int in_drv_pending(in_dev_t *dev)
+{
+	return DRV(dev->drv_id).pending != NULL
+		&& DRV(dev->drv_id).pending(dev->drv_data);
+}
+
+static void *in_thread_main(void *arg)
+{
+	int ready[IN_MAX_DEVS];
+	struct in_event ev;
+	struct in_evq *q;
+	in_dev_t *dev;
+	int i, n, fd, kc, is_down;
+
+	while (!in_thread_quit)
+	{
+		n = plat_wait_set_wait(in_thread_ws, ready, IN_MAX_DEVS,
+			PLAT_WAIT_FOREVER);
+		if (n < 0)
+			break;
+
+		pthread_mutex_lock(&in_thread_mutex);
+		while (n-- > 0) {
+			fd = ready[n];
+			for (i = 0; i < in_dev_count; i++)
+				if (in_evqs[i].active && in_devices[i].drv_fd_hnd == fd)
+					break;
+			if (i == in_dev_count) {
+				// a hotplug fd; it stays readable until the
+				// consumer drains it, so stop watching till then
+				in_thread_hotplug_fds(0);
+				in_thread_hotplug = 1;
+				continue;
+			}
+
+			dev = &in_devices[i];
+			do {
+				ev.time_ns = 0;
+				if (DRV(dev->drv_id).update_keycode_ts != NULL)
+					kc = DRV(dev->drv_id).update_keycode_ts(
+						dev->drv_data, &is_down, &ev.time_ns);
+				else {
+					kc = DRV(dev->drv_id).update_keycode(
+						dev->drv_data, &is_down);
+					ev.time_ns = plat_get_ticks_ns();
+				}
+				if (kc == -2) {
+					// gone, don't spin on its error state, and
+					// don't leave its keys held for in_update()
+					plat_wait_set_remove(in_thread_ws, fd);
+					memset(in_evqs[i].keys, 0, ((dev->key_count
+						+ 31) / 32) * sizeof(in_evqs[i].keys[0]));
+					__sync_synchronize();
+					in_evqs[i].active = 0;
+					break;
+				}
+				if (kc < 0 || kc >= dev->key_count)
+					continue;
+
+				q = &in_evqs[i];
+				if (q->head - q->tail >= IN_EVQ_SIZE) {
+					q->dropped++;
+					continue;
+				}
+				ev.keycode = kc;
+				ev.is_down = is_down;
+				q->ev[q->head % IN_EVQ_SIZE] = ev;
+				__sync_synchronize(); /* event before head */
+				q->head++;
+			}
+			while (in_drv_pending(dev));
+		}
+		pthread_mutex_unlock(&in_thread_mutex);
+	}
+
+	return NULL;
+}
+
+/* gets device i ready for the thread, 0 if the thread serves it now */
+static int in_thread_add_dev(int i)
+{
+	in_dev_t *dev = &in_devices[i];
+	struct in_evq *q = &in_evqs[i];
+	int words = (dev->key_count + 31) / 32;
+
+	memset(q, 0, sizeof(*q));
+	if (!dev->probed || dev->drv_fd_hnd == -1 || dev->binds == NULL)
+		return -1;
+
+	q->keys = calloc(words, sizeof(q->keys[0]));
+	if (q->keys == NULL)
+		return -1;
+
+	DRV(dev->drv_id).set_config(dev->drv_data, IN_CFG_BLOCKING, 0);
+	/* keys may already be held */
+	if (DRV(dev->drv_id).update_keybits != NULL)
+		DRV(dev->drv_id).update_keybits(dev->drv_data, q->keys, words);
+	if (plat_wait_set_add(in_thread_ws, dev->drv_fd_hnd) != 0) {
+		free(q->keys);
+		q->keys = NULL;
+		return -1;
+	}
+	q->active = 1;
+	return 0;
+}
+
+/* the hotplug fds of all drivers, so that the thread can flag them */
+static void in_thread_hotplug_fds(int add)
+{
+	int i, fd;
+
+	for (i = 0; i < in_driver_count; i++) {
+		if (in_drivers[i].get_hotplug_fd == NULL)
+			continue;
+		fd = in_drivers[i].get_hotplug_fd();
+		if (fd == -1)
+			continue;
+		if (add)
+			plat_wait_set_add(in_thread_ws, fd);
+		else
+			plat_wait_set_remove(in_thread_ws, fd);
+	}
+}
+
+static void in_thread_remove_dev(int i)
+{
+	struct in_evq *q = &in_evqs[i];
+
+	if (q->active)
+		plat_wait_set_remove(in_thread_ws, in_devices[i].drv_fd_hnd);
+	if (q->dropped)
+		lprintf("input: dev %d: %u events dropped\n", i, q->dropped);
+	free(q->keys);
+	memset(q, 0, sizeof(*q));
+}
+
+int in_thread_start(void)
+{
+	int i, ret, count = 0;
+
+	if (in_thread_running)
+		return 0;
+
+	in_thread_ws = plat_wait_set_create();
+	if (in_thread_ws == NULL)
+		return -1;
+
+	for (i = 0; i < in_dev_count; i++)
+		if (in_thread_add_dev(i) == 0)
+			count++;
+
+	if (count == 0) {
+		lprintf("input: no devices for the input thread\n");
+		goto fail;
+	}
+
+	in_thread_hotplug = 0;
+	in_thread_hotplug_fds(1);
+	in_thread_quit = 0;
+	ret = pthread_create(&in_thread, NULL, in_thread_main, NULL);
+	if (ret != 0) {
+		lprintf("input: pthread_create: %d\n", ret);
+		goto fail;
 	}
 
+	in_thread_running = 1;
+	return 0;
+
+fail:
+	for (i = 0; i < IN_MAX_DEVS; i++) {
+		free(in_evqs[i].keys);
+		memset(&in_evqs[i], 0, sizeof(in_evqs[i]));
+	}
+	plat_wait_set_destroy(in_thread_ws);
+	in_thread_ws = NULL;
+	return -1;
+}
+
+void in_thread_stop(void)
+{
+	int i;
+
+	if (!in_thread_running)
+		return;
+
+	in_thread_quit = 1;
+	plat_wait_set_wake(in_thread_ws);
+	pthread_join(in_thread, NULL);
+	in_thread_running = 0;
+
+	for (i = 0; i < IN_MAX_DEVS; i++)
+		in_thread_remove_dev(i);
+	plat_wait_set_destroy(in_thread_ws);
+	in_thread_ws = NULL;
+}
+
+/* consumer side */
+static int in_evq_pop(struct in_evq *q, uint64_t time_ns, struct in_event *ev)
+{
+	if (q->tail == q->head)
+		return -1;
+	__sync_synchronize(); /* head before event */
+
+	*ev = q->ev[q->tail % IN_EVQ_SIZE];
+	if (ev->time_ns > time_ns)
+		return -1;
+
+	if (ev->is_down)
+		q->keys[ev->keycode / 32] |=  1u << (ev->keycode & 31);
+	else
+		q->keys[ev->keycode / 32] &= ~(1u << (ev->keycode & 31));
+
+	__sync_synchronize(); /* done with the slot */
+	q->tail++;
+	return 0;
+}
+
+int in_thread_get_event(int *dev_id, struct in_event *ev)
+{
+	struct in_event e;
+	int i, best = -1;
+
+	// oldest first over all devices
+	for (i = 0; i < in_dev_count; i++) {
+		struct in_evq *q = &in_evqs[i];
+		if (!q->active || q->tail == q->head)
+			continue;
+		__sync_synchronize();
+		e = q->ev[q->tail % IN_EVQ_SIZE];
+		if (best < 0 || e.time_ns < ev->time_ns) {
+			*ev = e;
+			best = i;
+		}
+	}
+
+	if (best < 0)
+		return -1;
+
+	in_evq_pop(&in_evqs[best], ev->time_ns, ev);
+	if (dev_id != NULL)
+		*dev_id = best;
+	return 0;
+}
+
+int in_update_at(uint64_t time_ns, int *result)
+{
+	int res[IN_BINDTYPE_COUNT] = { 0, };
+	const struct in_bind_table *t;
+	struct in_event ev;
+	int i, ret = 0;
+
+	in_hotplug_frame();
+
+	for (i = 0; i < in_dev_count; i++) {
+		in_dev_t *dev = &in_devices[i];
+		struct in_evq *q = &in_evqs[i];
+
+		if (!dev->probed || dev->binds == NULL)
+			continue;
+		if (!q->active) {
+			ret |= in_update_dev(dev, res);
+			continue;
+		}
+
+		while (in_evq_pop(q, time_ns, &ev) == 0)
+			;
+
+		t = in_get_bind_table(dev);
+		if (t != NULL)
+			in_bind_table_apply(t, q->keys, res);
+	}
+
+	in_update_done(res, result);
 	return ret;
 }
 
@@ -304,15 +839,86 @@ int in_update_analog(int dev_id, int axis_id, int *result)
 	return DRV(dev->drv_id).update_analog(dev->drv_data, axis_id, result);
 }
 
+static int in_wait_set_add(int *fds, int count, int fd)
+{
+	int i;
+
+	// async devices of one driver may share their wakeup fd
+	for (i = 0; i < count; i++)
+		if (fds[i] == fd)
+			return count;
+
+	if (plat_wait_set_add(in_wait_set, fd) == 0)
+		fds[count++] = fd;
+	return count;
+}
+
+/* devices with events buffered in the driver are ready without waiting */
+static int in_get_pending(int *ready)
+{
+	int i, count = 0;
+
+	for (i = 0; i < in_dev_count; i++) {
+		in_dev_t *d = &in_devices[i];
+		if (d->probed && d->drv_fd_hnd != -1 && in_drv_pending(d))
+			ready[count++] = d->drv_fd_hnd;
+	}
+
+	return count;
+}
+
+/* returns the number of handles to wait on */
+static int in_wait_set_update(void)
+{
+	int fds[IN_MAX_DEVS];
+	int i, fd, count = 0;
+
+	plat_wait_set_destroy(in_wait_set);
+	in_wait_set = plat_wait_set_create();
+	if (in_wait_set == NULL)
+		return -1;
+
+	in_have_polled_devs = 0;
+	for (i = 0; i < in_dev_count; i++) {
+		in_dev_t *d = &in_devices[i];
+		if (!d->probed)
+			continue;
+
+		fd = d->drv_fd_hnd;
+		if (fd == -1)
+			fd = DRV(d->drv_id).get_wakeup_fd(d->drv_data);
+		if (fd != -1)
+			count = in_wait_set_add(fds, count, fd);
+		else
+			in_have_polled_devs = 1;
+	}
+
+	/* so that a new device wakes up the wait */
+	for (i = 0; i < in_driver_count; i++) {
+		if (in_drivers[i].get_hotplug_fd == NULL)
+			continue;
+		fd = in_drivers[i].get_hotplug_fd();
+		if (fd != -1)
+			count = in_wait_set_add(fds, count, fd);
+	}
+
+	in_wait_set_dirty = 0;
+	return count;
+}
+
 static int in_update_kc_async(int *dev_id_out, int *is_down_out, int timeout_ms)
 {
+	int ready[IN_MAX_DEVS];
 	int i, is_down, result;
-	unsigned int ticks;
+	uint64_t now, deadline = PLAT_WAIT_FOREVER, wait_till;
 
-	ticks = plat_get_ticks_ms();
+	if (timeout_ms >= 0)
+		deadline = plat_get_ticks_ns() + timeout_ms * 1000000ull;
 
 	while (1)
 	{
+		in_hotplug();
+
 		for (i = 0; i < in_dev_count; i++) {
 			in_dev_t *d = &in_devices[i];
 			if (!d->probed)
@@ -329,38 +935,37 @@ static int in_update_kc_async(int *dev_id_out, int *is_down_out, int timeout_ms)
 			return result;
 		}
 
-		if (timeout_ms >= 0 && (int)(plat_get_ticks_ms() - ticks) > timeout_ms)
+		now = plat_get_ticks_ns();
+		if (now >= deadline)
 			break;
 
-		plat_sleep_ms(10);
+		if (in_wait_set_dirty && in_wait_set_update() < 0) {
+			plat_sleep_ms(10);
+			continue;
+		}
+
+		// sleep until some device signals input, everything gets
+		// polled again after, so which one doesn't matter.
+		// Devices that can't signal are still polled every 10ms
+		wait_till = deadline;
+		if (in_have_polled_devs && now + 10000000 < wait_till)
+			wait_till = now + 10000000;
+		plat_wait_set_wait(in_wait_set, ready, IN_MAX_DEVS, wait_till);
 	}
 
 	return -1;
 }
 
-/* 
- * wait for a press, always return some keycode or -1 on timeout or error
- */
-int in_update_keycode(int *dev_id_out, int *is_down_out, char *charcode, int timeout_ms)
+/* for platforms without plat_wait_set_*(), select() style waits */
+static int in_update_kc_compat(int *dev_id_out, int *is_down_out, int timeout_ms)
 {
-	int result = -1, dev_id = 0, is_down, result_menu;
 	int fds_hnds[IN_MAX_DEVS];
-	int i, ret, count = 0;
-	in_drv_t *drv = NULL;
-	unsigned int ticks;
-
-	if (in_have_async_devs) {
-		result = in_update_kc_async(&dev_id, &is_down, timeout_ms);
-		if (result == -1)
-			return -1;
-		drv = &DRV(in_devices[dev_id].drv_id);
-		goto finish;
-	}
-
-	ticks = plat_get_ticks_ms();
+	int i, ret, count = 0, dev_id = 0, result = -1;
+	uint64_t deadline = 0, now;
+	in_drv_t *drv;
 
 	for (i = 0; i < in_dev_count; i++) {
-		if (in_devices[i].probed)
+		if (in_devices[i].probed && in_devices[i].drv_fd_hnd != -1)
 			fds_hnds[count++] = in_devices[i].drv_fd_hnd;
 	}
 
@@ -370,6 +975,9 @@ int in_update_keycode(int *dev_id_out, int *is_down_out, char *charcode, int tim
 		exit(1);
 	}
 
+	if (timeout_ms >= 0)
+		deadline = plat_get_ticks_ns() + timeout_ms * 1000000ull;
+
 	while (1)
 	{
 		ret = plat_wait_event(fds_hnds, count, timeout_ms);
@@ -384,7 +992,7 @@ int in_update_keycode(int *dev_id_out, int *is_down_out, char *charcode, int tim
 		}
 
 		drv = &DRV(in_devices[dev_id].drv_id);
-		result = drv->update_keycode(in_devices[dev_id].drv_data, &is_down);
+		result = drv->update_keycode(in_devices[dev_id].drv_data, is_down_out);
 		if (result >= 0)
 			break;
 
@@ -395,11 +1003,105 @@ int in_update_keycode(int *dev_id_out, int *is_down_out, char *charcode, int tim
 		}
 
 		if (timeout_ms >= 0) {
-			unsigned int ticks2 = plat_get_ticks_ms();
-			timeout_ms -= ticks2 - ticks;
-			ticks = ticks2;
-			if (timeout_ms <= 0)
+			now = plat_get_ticks_ns();
+			if (now >= deadline)
+				break;
+			timeout_ms = (deadline - now + 999999) / 1000000;
+		}
+	}
+
+	*dev_id_out = dev_id;
+	return result;
+}
+
+/* 
+ * wait for a press, always return some keycode or -1 on timeout or error
+ */
+int in_update_keycode(int *dev_id_out, int *is_down_out, char *charcode, int timeout_ms)
+{
+	int result = -1, dev_id = 0, is_down, result_menu;
+	int ready[IN_MAX_DEVS], ready_count = 0;	/* not serviced yet */
+	int i, fd_hnd, count;
+	in_drv_t *drv = NULL;
+	uint64_t deadline = PLAT_WAIT_FOREVER;
+
+	if (in_have_async_devs) {
+		result = in_update_kc_async(&dev_id, &is_down, timeout_ms);
+		if (result == -1)
+			return -1;
+		drv = &DRV(in_devices[dev_id].drv_id);
+		goto finish;
+	}
+
+	if (timeout_ms >= 0)
+		deadline = plat_get_ticks_ns() + timeout_ms * 1000000ull;
+
+	if (in_wait_set_dirty) {
+		count = in_wait_set_update();
+		if (count < 0) {
+			/* no wait sets here (or creating one failed) */
+			result = in_update_kc_compat(&dev_id, &is_down, timeout_ms);
+			if (result < 0)
+				return -1;
+			drv = &DRV(in_devices[dev_id].drv_id);
+			goto finish;
+		}
+		if (count == 0) {
+			/* don't deadlock, fail */
+			lprintf("input: failed to find devices to read\n");
+			exit(1);
+		}
+	}
+
+	while (1)
+	{
+		if (ready_count == 0) {
+			if (in_wait_set_dirty && in_wait_set_update() < 0)
+				break;
+			ready_count = in_get_pending(ready);
+		}
+		if (ready_count == 0) {
+			ready_count = plat_wait_set_wait(in_wait_set,
+				ready, IN_MAX_DEVS, deadline);
+			if (ready_count < 0)
 				break;
+			if (ready_count == 0) {
+				if (deadline != PLAT_WAIT_FOREVER
+				    && plat_get_ticks_ns() >= deadline)
+					break;
+				continue;
+			}
+		}
+
+		// service the ready devices one by one; only those reported
+		// ready in this call, devices may be in blocking mode and
+		// older reports may have been drained (in_update()) since.
+		// The wait is level triggered, so the next call finds the
+		// rest again
+		fd_hnd = ready[--ready_count];
+		for (i = 0; i < in_dev_count; i++) {
+			if (in_devices[i].probed && in_devices[i].drv_fd_hnd == fd_hnd) {
+				dev_id = i;
+				break;
+			}
+		}
+		if (i == in_dev_count) {
+			// a hotplug fd. The devices may change under the
+			// rest of the list, so wait again after
+			in_hotplug();
+			ready_count = 0;
+			continue;
+		}
+
+		drv = &DRV(in_devices[dev_id].drv_id);
+		result = drv->update_keycode(in_devices[dev_id].drv_data, &is_down);
+		if (result >= 0)
+			break;
+
+		if (result == -2) {
+			lprintf("input: \"%s\" errored out, removing.\n", in_devices[dev_id].name);
+			in_unprobe(&in_devices[dev_id]);
+			break;
 		}
 	}
 
@@ -416,6 +1118,10 @@ finish:
 			menu_key_state &= ~result_menu;
 	}
 
+	if (in_rec_key != NULL)
+		in_rec_key(result, is_down, result_menu,
+			(charcode != NULL && (result_menu & PBTN_CHAR)) ? *charcode : 0);
+
 	if (dev_id_out != NULL)
 		*dev_id_out = dev_id;
 	if (is_down_out != NULL)
@@ -423,6 +1129,13 @@ finish:
 	return result;
 }
 
+void in_set_recorder(void (*frame)(const int *result),
+	void (*key)(int keycode, int is_down, int menu, int charcode))
+{
+	in_rec_frame = frame;
+	in_rec_key = key;
+}
+
 /* same as above, only return bitfield of PBTN_*  */
 int in_menu_wait_any(char *charcode, int timeout_ms)
 {
@@ -722,6 +1435,7 @@ int in_bind_key(int dev_id, int keycode, int mask, int bind_type, int force_unbi
 		free(dev->binds);
 		dev->binds = NULL;
 	}
+	in_binds_changed(dev);
 
 	return 0;
 }
@@ -758,6 +1472,7 @@ void in_unbind_all(int dev_id_, int act_mask, int bind_type)
 		}
 		else
 			memset(dev->binds, 0, sizeof(dev->binds[0]) * count * IN_BINDTYPE_COUNT);
+		in_binds_changed(dev);
 	}
 }
 
@@ -861,6 +1576,8 @@ int in_config_bind_key(int dev_id, const char *key, int acts, int bind_type)
 		return -1;
 	}
 
+	in_binds_changed(dev);
+
 	if (bind_type == IN_BINDTYPE_NONE) {
 		for (i = 0; i < IN_BINDTYPE_COUNT; i++)
 			dev->binds[IN_BIND_OFFS(kc, i)] = 0;
@@ -895,6 +1612,7 @@ void in_clean_binds(void)
 			free(dev->binds);
 			dev->binds = NULL;
 		}
+		in_binds_changed(dev);
 	}
 }
 
@@ -923,6 +1641,7 @@ static int  in_def_update_keycode(void *drv_data, int *is_down) { return 0; }
 static int  in_def_menu_translate(void *drv_data, int keycode, char *ccode) { return 0; }
 static int  in_def_get_key_code(const char *key_name) { return -1; }
 static const char *in_def_get_key_name(int keycode) { return NULL; }
+static int  in_def_get_wakeup_fd(void *drv_data) { return -1; }
 
 #define CHECK_ADD_STUB(d, f) \
 	if (d.f == NULL) d.f = in_def_##f
@@ -950,6 +1669,7 @@ int in_register_driver(const in_drv_t *drv, const struct in_default_bind *defbin
 	CHECK_ADD_STUB(new_drivers[in_driver_count], menu_translate);
 	CHECK_ADD_STUB(new_drivers[in_driver_count], get_key_code);
 	CHECK_ADD_STUB(new_drivers[in_driver_count], get_key_name);
+	CHECK_ADD_STUB(new_drivers[in_driver_count], get_wakeup_fd);
 	if (defbinds != NULL)
 		new_drivers[in_driver_count].defbinds = defbinds;
 	in_drivers = new_drivers;
@@ -1,6 +1,8 @@
 #ifndef INCLUDE_uXt8Z4R7EMpuEEtvSibXjNhKH3741VNc
 #define INCLUDE_uXt8Z4R7EMpuEEtvSibXjNhKH3741VNc 1
 
+#include <stdint.h>
+
 #define IN_MAX_DEVS 10
 #define IN_ABS_RANGE 1024	/* abs must be centered at 0, move upto +- this */
 
@@ -86,16 +88,42 @@ typedef struct {
 	int  (*get_config)(void *drv_data, int what, int *val);
 	int  (*set_config)(void *drv_data, int what, int val);
 	int  (*update)(void *drv_data, const int *binds, int *result);
+	/* preferred over update(): set the bits of pressed keys in keybits
+	 * (zeroed, words * 32 keys), input.c applies compiled binds */
+	int  (*update_keybits)(void *drv_data, uint32_t *keybits, int words);
 	int  (*update_analog)(void *drv_data, int axis_id, int *result);
 	/* return -1 on no event, -2 on error */
 	int  (*update_keycode)(void *drv_data, int *is_down);
+	/* same, also returning the event time (plat_get_ticks_ns() clock),
+	 * optional, used by the input thread */
+	int  (*update_keycode_ts)(void *drv_data, int *is_down, uint64_t *time_ns);
+	/* optional: nonzero if events were read ahead and are buffered,
+	 * update_keycode() should be called without waiting on the fd */
+	int  (*pending)(void *drv_data);
 	int  (*menu_translate)(void *drv_data, int keycode, char *charcode);
 	int  (*get_key_code)(const char *key_name);
 	const char * (*get_key_name)(int keycode);
+	/* async devices: fd that gets readable when input may be pending,
+	 * -1 if the device can only be polled */
+	int  (*get_wakeup_fd)(void *drv_data);
+	/* optional: pick up added/removed devices with in_register()/
+	 * in_unregister(), called often, should be cheap when idle;
+	 * the fd gets readable when there is something to do. With the
+	 * input thread running, only the devices added or removed are
+	 * taken to or from it; it's not servicing any device meanwhile */
+	void (*hotplug)(void);
+	int  (*get_hotplug_fd)(void);
 
 	const struct in_default_bind *defbinds;
 } in_drv_t;
 
+/* timestamped key event, from the input thread */
+struct in_event {
+	uint64_t time_ns;	/* plat_get_ticks_ns() clock */
+	int keycode;
+	int is_down;
+};
+
 struct in_default_bind {
 	unsigned short code;
 	unsigned char btype;    /* IN_BINDTYPE_* */
@@ -106,12 +134,32 @@ struct in_default_bind {
 int  in_register_driver(const in_drv_t *drv, const struct in_default_bind *defbinds);
 void in_register(const char *nname, int drv_fd_hnd, void *drv_data,
 		int key_count, const char * const *key_names, int combos);
+/* hotplug: the device registered with drv_data is gone, frees it */
+void in_unregister(void *drv_data);
+/* for in_replay.c: get in_update() results and in_update_keycode()
+ * events with their menu_translate() result, NULL hooks to stop */
+void in_set_recorder(void (*frame)(const int *result),
+	void (*key)(int keycode, int is_down, int menu, int charcode));
 void in_combos_find(const int *binds, int last_key, int *combo_keys, int *combo_acts);
 int  in_combos_do(int keys, const int *binds, int last_key, int combo_keys, int combo_acts);
 
 void in_init(void);
 void in_probe(void);
 int  in_update(int *result);
+
+/* Optional input thread: fd devices (evdev) are read as events arrive
+ * and queued with their times, instead of being sampled once per
+ * in_update(). Async devices (SDL) are still handled by the caller's
+ * thread. While it runs, in_update_at() is the call to use; in_update()
+ * works as in_update_at() with all queued events. Stop it before
+ * using in_update_keycode()/menu functions. */
+int  in_thread_start(void);
+void in_thread_stop(void);
+/* key state as of time_ns, later events stay queued; binds are
+ * applied like in_update() does (no combos) */
+int  in_update_at(uint64_t time_ns, int *result);
+/* pop the oldest queued event, -1 if none */
+int  in_thread_get_event(int *dev_id, struct in_event *ev);
 int  in_update_analog(int dev_id, int axis_id, int *value);
 int  in_update_keycode(int *dev_id, int *is_down, char *charcode, int timeout_ms);
 int  in_menu_wait_any(char *charcode, int timeout_ms);
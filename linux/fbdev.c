@@ -18,13 +18,18 @@
 #include <sys/ioctl.h>
 #include <sys/mman.h>
 #include <unistd.h>
+#include <pthread.h>
 #include <linux/fb.h>
 #include <linux/matroxfb.h>
 
 #include "fbdev.h"
+#include "../plat.h"
+#include "../vout_stats.h"
 
 #define PFX "fbdev: "
 
+#define MAX_BUFFERS 8
+
 struct vout_fbdev {
 	int	fd;
 	void	*mem;
@@ -37,33 +42,261 @@ struct vout_fbdev {
 	int	top_border, bottom_border;
 	void	*mem_saved;
 	size_t	mem_saved_size;
+	int	buffer_shown;
+	/* async mode */
+	int	async;
+	int	thread_running;
+	int	thread_quit;
+	pthread_t thread;
+	pthread_mutex_t mutex;
+	pthread_cond_t cond;
+	int	queue[MAX_BUFFERS];	/* buffers waiting to be shown */
+	unsigned int queue_ids[MAX_BUFFERS];	/* their vout_stats ids */
+	int	queue_len;
+	/* sync mode flip that's not known to be on screen yet */
+	unsigned int pending_id;
+	uint64_t pending_pan_ns;
+	int	pending;
+	int	vsync;		/* last vout_stats_set_vsync() */
 };
 
+static int buffer_yoffset(struct vout_fbdev *fbdev, int buf)
+{
+	return (fbdev->top_border + fbdev->fbvar_new.yres + fbdev->bottom_border) * buf +
+		fbdev->top_border;
+}
+
+/* vblank period from the mode timings, 0 if the driver leaves them
+ * out (many do) or they make no sense */
+static unsigned int mode_period_us(const struct fb_var_screeninfo *v)
+{
+	uint64_t htotal, vtotal, period;
+
+	if (v->pixclock == 0)
+		return 0;
+
+	htotal = v->left_margin + v->xres + v->right_margin + v->hsync_len;
+	vtotal = v->upper_margin + v->yres + v->lower_margin + v->vsync_len;
+	if (v->vmode & FB_VMODE_INTERLACED)
+		vtotal /= 2;
+	if (v->vmode & FB_VMODE_DOUBLE)
+		vtotal *= 2;
+
+	// pixclock is in picoseconds
+	period = (uint64_t)v->pixclock * htotal * vtotal / 1000000;
+	if (period < 4000 || period > 100000)
+		return 0;
+	return period;
+}
+
+/* present times are only vblank times after a successful vsync wait */
+static void set_vsync(struct vout_fbdev *fbdev, int vsync)
+{
+	if (fbdev->vsync != vsync) {
+		fbdev->vsync = vsync;
+		vout_stats_set_vsync(vsync);
+	}
+}
+
+/*
+ * Async mode: flip only queues the buffer and a thread pans to it and
+ * waits for vsync, after which the previously shown buffer is free
+ * again. The caller gets a buffer that's neither shown nor queued, and
+ * only has to wait if there is none (with 3 buffers, when it's 2
+ * frames ahead of the display).
+ */
+static void *flip_thread(void *arg)
+{
+	struct vout_fbdev *fbdev = arg;
+	struct fb_var_screeninfo fbvar;
+	unsigned int id;
+	int buf, vsync_arg, vsync;
+
+	pthread_mutex_lock(&fbdev->mutex);
+	while (1) {
+		while (fbdev->queue_len == 0 && !fbdev->thread_quit)
+			pthread_cond_wait(&fbdev->cond, &fbdev->mutex);
+		if (fbdev->thread_quit)
+			break;
+
+		buf = fbdev->queue[0];
+		id = fbdev->queue_ids[0];
+		fbvar = fbdev->fbvar_new;
+		fbvar.yoffset = buffer_yoffset(fbdev, buf);
+		pthread_mutex_unlock(&fbdev->mutex);
+
+		// pan is latched on vblank, the old buffer is free after it
+		ioctl(fbdev->fd, FBIOPAN_DISPLAY, &fbvar);
+		vsync_arg = 0;
+		vsync = ioctl(fbdev->fd, FBIO_WAITFORVSYNC, &vsync_arg) == 0;
+		vout_stats_present(id, plat_get_ticks_ns());
+		set_vsync(fbdev, vsync);
+
+		pthread_mutex_lock(&fbdev->mutex);
+		fbdev->queue_len--;
+		memmove(fbdev->queue, fbdev->queue + 1,
+			fbdev->queue_len * sizeof(fbdev->queue[0]));
+		memmove(fbdev->queue_ids, fbdev->queue_ids + 1,
+			fbdev->queue_len * sizeof(fbdev->queue_ids[0]));
+		fbdev->buffer_shown = buf;
+		pthread_cond_broadcast(&fbdev->cond);
+	}
+	pthread_mutex_unlock(&fbdev->mutex);
+
+	return NULL;
+}
+
+static int buffer_busy(struct vout_fbdev *fbdev, int buf)
+{
+	int i;
+
+	if (buf == fbdev->buffer_shown)
+		return 1;
+	for (i = 0; i < fbdev->queue_len; i++)
+		if (fbdev->queue[i] == buf)
+			return 1;
+	return 0;
+}
+
+static void *vout_fbdev_flip_async(struct vout_fbdev *fbdev)
+{
+	int i, buf;
+
+	pthread_mutex_lock(&fbdev->mutex);
+	fbdev->queue_ids[fbdev->queue_len] = vout_stats_submit(fbdev->queue_len);
+	fbdev->queue[fbdev->queue_len++] = fbdev->buffer_write;
+	pthread_cond_broadcast(&fbdev->cond);
+
+	for (;;) {
+		for (i = 1; i <= fbdev->buffer_count; i++) {
+			buf = (fbdev->buffer_write + i) % fbdev->buffer_count;
+			if (!buffer_busy(fbdev, buf))
+				goto found;
+		}
+		pthread_cond_wait(&fbdev->cond, &fbdev->mutex);
+	}
+
+found:
+	fbdev->buffer_write = buf;
+	pthread_mutex_unlock(&fbdev->mutex);
+
+	return (char *)fbdev->mem + fbdev->fb_size * fbdev->buffer_write;
+}
+
+static void async_start(struct vout_fbdev *fbdev)
+{
+	if (!fbdev->async || fbdev->thread_running || fbdev->buffer_count < 2)
+		return;
+
+	fbdev->queue_len = 0;
+	fbdev->thread_quit = 0;
+	if (pthread_create(&fbdev->thread, NULL, flip_thread, fbdev) != 0) {
+		fprintf(stderr, PFX "pthread_create failed, async flips disabled\n");
+		return;
+	}
+	fbdev->thread_running = 1;
+}
+
+/* lets queued flips finish */
+static void async_stop(struct vout_fbdev *fbdev)
+{
+	if (!fbdev->thread_running)
+		return;
+
+	pthread_mutex_lock(&fbdev->mutex);
+	while (fbdev->queue_len > 0)
+		pthread_cond_wait(&fbdev->cond, &fbdev->mutex);
+	fbdev->thread_quit = 1;
+	pthread_cond_broadcast(&fbdev->cond);
+	pthread_mutex_unlock(&fbdev->mutex);
+
+	pthread_join(fbdev->thread, NULL);
+	fbdev->thread_running = 0;
+}
+
+int vout_fbdev_set_async(struct vout_fbdev *fbdev, int enable)
+{
+	if (!enable) {
+		async_stop(fbdev);
+		fbdev->async = 0;
+		return 0;
+	}
+
+	fbdev->async = 1;
+	async_start(fbdev);
+	return fbdev->thread_running ? 0 : -1;
+}
+
+int vout_fbdev_get_draw_buffer(struct vout_fbdev *fbdev)
+{
+	return fbdev->buffer_write;
+}
+
+int vout_fbdev_get_queued(struct vout_fbdev *fbdev)
+{
+	int ret;
+
+	if (!fbdev->thread_running)
+		return 0;
+
+	pthread_mutex_lock(&fbdev->mutex);
+	ret = fbdev->queue_len;
+	pthread_mutex_unlock(&fbdev->mutex);
+
+	return ret;
+}
+
+/* without a vsync wait, the pan is the best guess for presentation */
+static void sync_present(struct vout_fbdev *fbdev, uint64_t present_ns)
+{
+	if (fbdev->pending)
+		vout_stats_present(fbdev->pending_id, present_ns);
+	fbdev->pending = 0;
+}
+
 void *vout_fbdev_flip(struct vout_fbdev *fbdev)
 {
 	int draw_buf;
 
-	if (fbdev->buffer_count < 2)
+	if (fbdev->thread_running)
+		return vout_fbdev_flip_async(fbdev);
+
+	// still pending, so nobody waited for vsync
+	if (fbdev->pending)
+		set_vsync(fbdev, 0);
+	sync_present(fbdev, fbdev->pending_pan_ns);
+	fbdev->pending_id = vout_stats_submit(0);
+	fbdev->pending = 1;
+
+	if (fbdev->buffer_count < 2) {
+		fbdev->pending_pan_ns = plat_get_ticks_ns();
 		return fbdev->mem;
+	}
 
 	draw_buf = fbdev->buffer_write;
 	fbdev->buffer_write++;
 	if (fbdev->buffer_write >= fbdev->buffer_count)
 		fbdev->buffer_write = 0;
 
-	fbdev->fbvar_new.yoffset = 
-		(fbdev->top_border + fbdev->fbvar_new.yres + fbdev->bottom_border) * draw_buf +
-		fbdev->top_border;
+	fbdev->fbvar_new.yoffset = buffer_yoffset(fbdev, draw_buf);
 
 	ioctl(fbdev->fd, FBIOPAN_DISPLAY, &fbdev->fbvar_new);
+	fbdev->buffer_shown = draw_buf;
+	fbdev->pending_pan_ns = plat_get_ticks_ns();
 
 	return (char *)fbdev->mem + fbdev->fb_size * fbdev->buffer_write;
 }
 
 void vout_fbdev_wait_vsync(struct vout_fbdev *fbdev)
 {
-	int arg = 0;
-	ioctl(fbdev->fd, FBIO_WAITFORVSYNC, &arg);
+	int arg = 0, ret;
+	ret = ioctl(fbdev->fd, FBIO_WAITFORVSYNC, &arg);
+
+	if (!fbdev->thread_running) {
+		if (fbdev->pending)
+			set_vsync(fbdev, ret == 0);
+		sync_present(fbdev, plat_get_ticks_ns());
+	}
 }
 
 /* it is recommended to call vout_fbdev_clear() before this */
@@ -75,6 +308,8 @@ void *vout_fbdev_resize(struct vout_fbdev *fbdev, int w, int h, int bpp,
 	size_t mem_size;
 	int ret;
 
+	async_stop(fbdev);
+
 	// unblank to be sure the mode is really accepted
 	ioctl(fbdev->fd, FBIOBLANK, FB_BLANK_UNBLANK);
 
@@ -100,6 +335,7 @@ void *vout_fbdev_resize(struct vout_fbdev *fbdev, int w, int h, int bpp,
 		fbdev->fbvar_new.nonstd = 0; // can set YUV here on omapfb
 		fbdev->buffer_count = buffer_cnt;
 		fbdev->buffer_write = buffer_cnt > 1 ? 1 : 0;
+		fbdev->buffer_shown = 0;
 
 		// seems to help a bit to avoid glitches
 		vout_fbdev_wait_vsync(fbdev);
@@ -115,11 +351,13 @@ void *vout_fbdev_resize(struct vout_fbdev *fbdev, int w, int h, int bpp,
 			}
 			fbdev->buffer_count = 1;
 			fbdev->buffer_write = 0;
+			fbdev->buffer_shown = 0;
 			fprintf(stderr, PFX "Warning: failed to increase virtual resolution, "
 					"multibuffering disabled\n");
 		}
 
 	}
+	vout_stats_set_mode_refresh(mode_period_us(&fbdev->fbvar_new));
 
 	fbdev->fb_size = w_total * h_total * bpp / 8;
 	fbdev->top_border = top_border;
@@ -137,6 +375,7 @@ void *vout_fbdev_resize(struct vout_fbdev *fbdev, int w, int h, int bpp,
 		fprintf(stderr, PFX "Warning: can't map %zd bytes, doublebuffering disabled\n", mem_size);
 		fbdev->buffer_count = 1;
 		fbdev->buffer_write = 0;
+		fbdev->buffer_shown = 0;
 		mem_size = fbdev->fb_size;
 		fbdev->mem = mmap(0, mem_size, PROT_WRITE|PROT_READ, MAP_SHARED, fbdev->fd, 0);
 	}
@@ -150,6 +389,7 @@ void *vout_fbdev_resize(struct vout_fbdev *fbdev, int w, int h, int bpp,
 	fbdev->mem_size = mem_size;
 
 out:
+	async_start(fbdev);
 	return (char *)fbdev->mem + fbdev->fb_size * fbdev->buffer_write;
 }
 
@@ -183,10 +423,16 @@ struct vout_fbdev *vout_fbdev_init(const char *fbdev_name, int *w, int *h, int b
 	void *pret;
 	int ret;
 
+	if (buffer_cnt > MAX_BUFFERS)
+		buffer_cnt = MAX_BUFFERS;
+
 	fbdev = calloc(1, sizeof(*fbdev));
 	if (fbdev == NULL)
 		return NULL;
 
+	pthread_mutex_init(&fbdev->mutex, NULL);
+	pthread_cond_init(&fbdev->cond, NULL);
+
 	fbdev->fd = open(fbdev_name, O_RDWR);
 	if (fbdev->fd == -1) {
 		fprintf(stderr, PFX "%s: ", fbdev_name);
@@ -228,6 +474,7 @@ struct vout_fbdev *vout_fbdev_init(const char *fbdev_name, int *w, int *h, int b
 
 	if (fbdev->buffer_count > 1) {
 		fbdev->buffer_write = 0;
+		fbdev->buffer_shown = fbdev->buffer_count - 1;
 		fbdev->fbvar_new.yoffset = fbdev->fbvar_new.yres * (fbdev->buffer_count - 1);
 		ret = ioctl(fbdev->fd, FBIOPAN_DISPLAY, &fbdev->fbvar_new);
 		if (ret != 0) {
@@ -242,6 +489,8 @@ struct vout_fbdev *vout_fbdev_init(const char *fbdev_name, int *w, int *h, int b
 fail:
 	close(fbdev->fd);
 fail_open:
+	pthread_cond_destroy(&fbdev->cond);
+	pthread_mutex_destroy(&fbdev->mutex);
 	free(fbdev);
 	return NULL;
 }
@@ -269,6 +518,8 @@ int vout_fbdev_save(struct vout_fbdev *fbdev)
 			return -1;
 		fbdev->mem_saved = tmp;
 	}
+	async_stop(fbdev);
+
 	memcpy(fbdev->mem_saved, fbdev->mem, fbdev->mem_size);
 	fbdev->mem_saved_size = fbdev->mem_size;
 
@@ -298,15 +549,20 @@ int vout_fbdev_restore(struct vout_fbdev *fbdev)
 		return -1;
 	}
 
+	async_start(fbdev);
 	return 0;
 }
 
 void vout_fbdev_finish(struct vout_fbdev *fbdev)
 {
+	async_stop(fbdev);
 	vout_fbdev_release(fbdev);
+	vout_stats_set_mode_refresh(0);
 	if (fbdev->fd >= 0)
 		close(fbdev->fd);
 	fbdev->fd = -1;
+	pthread_cond_destroy(&fbdev->cond);
+	pthread_mutex_destroy(&fbdev->mutex);
 	free(fbdev);
 }
 
@@ -12,3 +12,9 @@ int   vout_fbdev_get_fd(struct vout_fbdev *fbdev);
 int   vout_fbdev_save(struct vout_fbdev *fbdev);
 int   vout_fbdev_restore(struct vout_fbdev *fbdev);
 void  vout_fbdev_finish(struct vout_fbdev *fbdev);
+
+/* async mode: flips are queued to a thread that pans on vsync,
+ * vout_fbdev_flip() then only blocks when there is no free buffer */
+int   vout_fbdev_set_async(struct vout_fbdev *fbdev, int enable);
+int   vout_fbdev_get_draw_buffer(struct vout_fbdev *fbdev);
+int   vout_fbdev_get_queued(struct vout_fbdev *fbdev);
@@ -17,17 +17,33 @@
 #include <fcntl.h>
 #include <sys/ioctl.h>
 #include <unistd.h>
+#include <time.h>
+#include <dirent.h>
+#include <sys/inotify.h>
 #include <linux/input.h>
 #include <errno.h>
 
 #include "../input.h"
+#include "../plat.h"
 #include "in_evdev.h"
 
-#define MAX_ABS_DEVS 8
+#ifndef KEY_CNT
+#define KEY_CNT (KEY_MAX + 1)
+#endif
+#ifndef ABS_CNT
+#define ABS_CNT (ABS_MAX + 1)
+#endif
+/* headers older than 4.16 lack these, and with 64bit time_t on
+ * 32bit the time member is gone */
+#ifndef input_event_sec
+#define input_event_sec time.tv_sec
+#define input_event_usec time.tv_usec
+#endif
 
-typedef struct {
+typedef struct in_evdev {
 	int fd;
-	int *kbits;
+	int node; /* N of /dev/input/eventN */
+	int kbits[KEY_CNT / 8 / sizeof(int)]; /* tracked from the event stream */
 	int abs_min_x; /* abs->digital mapping */
 	int abs_max_x;
 	int abs_min_y;
@@ -38,15 +54,20 @@ typedef struct {
 	int kc_first;
 	int kc_last;
 	unsigned int abs_count;
-	int abs_mult[MAX_ABS_DEVS]; /* 16.16 multiplier to IN_ABS_RANGE */
-	int abs_adj[MAX_ABS_DEVS];  /* adjust for centering */
+	int abs_val[ABS_CNT];  /* tracked from the event stream */
+	int abs_mult[ABS_CNT]; /* 16.16 multiplier to IN_ABS_RANGE */
+	int abs_adj[ABS_CNT];  /* adjust for centering */
 	unsigned int abs_to_digital:1;
+	unsigned int ts_monotonic:1; /* event times on plat_get_ticks_ns() clock */
+	unsigned int blocking:1;
+	/* events are read in batches and consumed in order from here
+	 * by both the game (update_keybits) and menu (update_keycode) paths */
+	struct input_event evbuf[64];
+	unsigned int evbuf_pos;
+	unsigned int evbuf_cnt;
+	struct in_evdev *next;
 } in_evdev_t;
 
-#ifndef KEY_CNT
-#define KEY_CNT (KEY_MAX + 1)
-#endif
-
 #define KEYBITS_BIT(x) (keybits[(x)/sizeof(keybits[0])/8] & \
 	(1 << ((x) & (sizeof(keybits[0])*8-1))))
 
@@ -58,6 +79,10 @@ typedef struct {
 
 int in_evdev_allow_abs_only;
 
+/* open devices, to match hotplug events against */
+static in_evdev_t *dev_list;
+static int hotplug_fd = -1;
+
 #define IN_EVDEV_PREFIX "evdev:"
 
 static const char * const in_evdev_keys[KEY_CNT] = {
@@ -147,144 +172,289 @@ static const char * const in_evdev_keys[KEY_CNT] = {
 };
 
 
-static void in_evdev_probe(void)
+/* fetch the whole state, at probe and when the kernel dropped events */
+static void in_evdev_resync(in_evdev_t *dev)
+{
+	struct input_absinfo ainfo;
+	unsigned int u;
+
+	/* without EVIOCGKEY keep what was tracked so far */
+	ioctl(dev->fd, EVIOCGKEY(sizeof(dev->kbits)), dev->kbits);
+
+	for (u = 0; u < dev->abs_count; u++) {
+		if (ioctl(dev->fd, EVIOCGABS(u), &ainfo) != -1)
+			dev->abs_val[u] = ainfo.value;
+	}
+}
+
+static void in_evdev_track(in_evdev_t *dev, const struct input_event *ev)
+{
+	int *keybits = dev->kbits;
+
+	switch (ev->type) {
+	case EV_KEY:
+		if (ev->code >= KEY_CNT)
+			break;
+		if (ev->value == 1)
+			KEYBITS_BIT_SET(ev->code);
+		else if (ev->value == 0)
+			KEYBITS_BIT_CLEAR(ev->code);
+		break;
+	case EV_ABS:
+		if (ev->code < ABS_CNT)
+			dev->abs_val[ev->code] = ev->value;
+		break;
+#ifdef SYN_DROPPED
+	case EV_SYN:
+		if (ev->code == SYN_DROPPED)
+			in_evdev_resync(dev);
+		break;
+#endif
+	}
+}
+
+/* refill the consumed event buffer, returns events read or -1.
+ * Batching is per device; the input thread and in_update_keycode()
+ * only get here for the devices their epoll wait reported, while the
+ * game path without the thread still reads each device every frame
+ * (cheaper than an epoll round trip for the few devices there are) */
+static int in_evdev_read(in_evdev_t *dev)
+{
+	int rd;
+
+	dev->evbuf_pos = dev->evbuf_cnt = 0;
+	rd = read(dev->fd, dev->evbuf, sizeof(dev->evbuf));
+	if (rd == -1) {
+		if (errno != EAGAIN) {
+			perror("in_evdev: error reading");
+			return -1;
+		}
+		return 0;
+	}
+
+	dev->evbuf_cnt = rd / sizeof(dev->evbuf[0]);
+	return dev->evbuf_cnt;
+}
+
+/* opens and registers /dev/input/eventN, returns 0 on success */
+static int in_evdev_open(int node)
 {
 	long keybits[KEY_CNT / sizeof(long) / 8];
 	long absbits[(ABS_MAX+1) / sizeof(long) / 8];
-	int i;
+	int support = 0, count = 0;
+	int u, ret, fd, kc_first = KEY_MAX, kc_last = 0, have_abs = 0;
+	in_evdev_t *dev;
+	char name[64];
 
 	// the kernel might support and return less keys then we know about,
 	// so make sure the buffers are clear.
 	memset(keybits, 0, sizeof(keybits));
 	memset(absbits, 0, sizeof(absbits));
 
-	for (i = 0;; i++)
-	{
-		int support = 0, count = 0;
-		int u, ret, fd, kc_first = KEY_MAX, kc_last = 0, have_abs = 0;
-		in_evdev_t *dev;
-		char name[64];
-
-		snprintf(name, sizeof(name), "/dev/input/event%d", i);
-		fd = open(name, O_RDONLY|O_NONBLOCK);
-		if (fd == -1) {
-			if (errno == EACCES)
-				continue;	/* maybe we can access next one */
-			break;
-		}
+	snprintf(name, sizeof(name), "/dev/input/event%d", node);
+	fd = open(name, O_RDONLY|O_NONBLOCK);
+	if (fd == -1)
+		return -1;
 
-		/* check supported events */
-		ret = ioctl(fd, EVIOCGBIT(0, sizeof(support)), &support);
+	/* check supported events */
+	ret = ioctl(fd, EVIOCGBIT(0, sizeof(support)), &support);
+	if (ret == -1) {
+		printf("in_evdev: ioctl failed on %s\n", name);
+		goto skip;
+	}
+
+	if (support & (1 << EV_KEY)) {
+		ret = ioctl(fd, EVIOCGBIT(EV_KEY, sizeof(keybits)), keybits);
 		if (ret == -1) {
 			printf("in_evdev: ioctl failed on %s\n", name);
 			goto skip;
 		}
 
-		if (support & (1 << EV_KEY)) {
-			ret = ioctl(fd, EVIOCGBIT(EV_KEY, sizeof(keybits)), keybits);
-			if (ret == -1) {
-				printf("in_evdev: ioctl failed on %s\n", name);
-				goto skip;
-			}
-
-			/* check for interesting keys */
-			for (u = 0; u < KEY_CNT; u++) {
-				if (KEYBITS_BIT(u)) {
-					if (u < kc_first)
-						kc_first = u;
-					if (u > kc_last)
-						kc_last = u;
-					if (u != KEY_POWER && u != KEY_SLEEP && u != BTN_TOUCH)
-						count++;
-					if (u == BTN_TOUCH) /* we can't deal with ts currently */
-						goto skip;
-				}
+		/* check for interesting keys */
+		for (u = 0; u < KEY_CNT; u++) {
+			if (KEYBITS_BIT(u)) {
+				if (u < kc_first)
+					kc_first = u;
+				if (u > kc_last)
+					kc_last = u;
+				if (u != KEY_POWER && u != KEY_SLEEP && u != BTN_TOUCH)
+					count++;
+				if (u == BTN_TOUCH) /* we can't deal with ts currently */
+					goto skip;
 			}
 		}
+	}
 
-		dev = calloc(1, sizeof(*dev));
-		if (dev == NULL)
-			goto skip;
-
-		ret = ioctl(fd, EVIOCGKEY(sizeof(keybits)), keybits);
-		if (ret == -1) {
-			printf("Warning: EVIOCGKEY not supported, will have to track state\n");
-			dev->kbits = calloc(KEY_CNT, sizeof(int));
-			if (dev->kbits == NULL) {
-				free(dev);
-				goto skip;
-			}
+	dev = calloc(1, sizeof(*dev));
+	if (dev == NULL)
+		goto skip;
+
+	/* check for abs too */
+	if (support & (1 << EV_ABS)) {
+		struct input_absinfo ainfo;
+		int dist;
+		ret = ioctl(fd, EVIOCGBIT(EV_ABS, sizeof(absbits)), absbits);
+		if (ret == -1)
+			goto no_abs;
+		if (absbits[0] & (1 << ABS_X)) {
+			ret = ioctl(fd, EVIOCGABS(ABS_X), &ainfo);
+			if (ret == -1)
+				goto no_abs;
+			dist = ainfo.maximum - ainfo.minimum;
+			dev->abs_lzone = dist / 4;
+			dev->abs_min_x = ainfo.minimum;
+			dev->abs_max_x = ainfo.maximum;
 		}
-
-		/* check for abs too */
-		if (support & (1 << EV_ABS)) {
-			struct input_absinfo ainfo;
-			int dist;
-			ret = ioctl(fd, EVIOCGBIT(EV_ABS, sizeof(absbits)), absbits);
+		if (absbits[0] & (1 << ABS_Y)) {
+			ret = ioctl(fd, EVIOCGABS(ABS_Y), &ainfo);
 			if (ret == -1)
 				goto no_abs;
-			if (absbits[0] & (1 << ABS_X)) {
-				ret = ioctl(fd, EVIOCGABS(ABS_X), &ainfo);
-				if (ret == -1)
-					goto no_abs;
-				dist = ainfo.maximum - ainfo.minimum;
-				dev->abs_lzone = dist / 4;
-				dev->abs_min_x = ainfo.minimum;
-				dev->abs_max_x = ainfo.maximum;
-			}
-			if (absbits[0] & (1 << ABS_Y)) {
-				ret = ioctl(fd, EVIOCGABS(ABS_Y), &ainfo);
-				if (ret == -1)
-					goto no_abs;
-				dist = ainfo.maximum - ainfo.minimum;
-				dev->abs_min_y = ainfo.minimum;
-				dev->abs_max_y = ainfo.maximum;
-			}
-			for (u = 0; u < MAX_ABS_DEVS; u++) {
-				ret = ioctl(fd, EVIOCGABS(u), &ainfo);
-				if (ret == -1)
-					break;
-				dist = ainfo.maximum - ainfo.minimum;
-				if (dist != 0)
-					dev->abs_mult[u] = IN_ABS_RANGE * 2 * 65536 / dist;
-				dev->abs_adj[u] = -(ainfo.maximum + ainfo.minimum + 1) / 2;
-				have_abs = 1;
-			}
-			dev->abs_count = u;
+			dist = ainfo.maximum - ainfo.minimum;
+			dev->abs_min_y = ainfo.minimum;
+			dev->abs_max_y = ainfo.maximum;
+		}
+		for (u = 0; u < ABS_CNT; u++) {
+			if (!(absbits[u / (sizeof(long) * 8)]
+			      & (1ul << (u % (sizeof(long) * 8)))))
+				continue;
+			ret = ioctl(fd, EVIOCGABS(u), &ainfo);
+			if (ret == -1)
+				continue;
+			dist = ainfo.maximum - ainfo.minimum;
+			if (dist != 0)
+				dev->abs_mult[u] = IN_ABS_RANGE * 2 * 65536 / dist;
+			dev->abs_adj[u] = -(ainfo.maximum + ainfo.minimum + 1) / 2;
+			dev->abs_count = u + 1;
+			have_abs = 1;
 		}
+	}
 
 no_abs:
-		if (count == 0 && !have_abs) {
-			free(dev);
-			goto skip;
-		}
+	if (count == 0 && !have_abs) {
+		free(dev);
+		goto skip;
+	}
 
-		dev->fd = fd;
-		dev->kc_first = kc_first;
-		dev->kc_last = kc_last;
-		if (count > 0 || in_evdev_allow_abs_only)
-			dev->abs_to_digital = 1;
-		strcpy(name, IN_EVDEV_PREFIX);
-		ioctl(fd, EVIOCGNAME(sizeof(name)-6), name+6);
-		printf("in_evdev: found \"%s\" with %d events (type %08x)\n",
-			name+6, count, support);
-		in_register(name, fd, dev, KEY_CNT, in_evdev_keys, 0);
-		continue;
+	dev->fd = fd;
+	dev->node = node;
+	dev->kc_first = kc_first;
+	dev->kc_last = kc_last;
+	if (count > 0 || in_evdev_allow_abs_only)
+		dev->abs_to_digital = 1;
+#ifdef EVIOCSCLOCKID
+	{
+		/* event times are gettimeofday() based by default */
+		int clk = CLOCK_MONOTONIC;
+		if (ioctl(fd, EVIOCSCLOCKID, &clk) == 0)
+			dev->ts_monotonic = 1;
+	}
+#endif
+	in_evdev_resync(dev);
+	strcpy(name, IN_EVDEV_PREFIX);
+	ioctl(fd, EVIOCGNAME(sizeof(name)-6), name+6);
+	printf("in_evdev: found \"%s\" with %d events (type %08x)\n",
+		name+6, count, support);
+	dev->next = dev_list;
+	dev_list = dev;
+	in_register(name, fd, dev, KEY_CNT, in_evdev_keys, 0);
+	return 0;
 
 skip:
-		close(fd);
+	close(fd);
+	return -1;
+}
+
+static void in_evdev_probe(void)
+{
+	struct dirent *ent;
+	DIR *dir;
+	int i, n, max = -1;
+
+	if (hotplug_fd == -1) {
+		hotplug_fd = inotify_init1(IN_NONBLOCK | IN_CLOEXEC);
+		if (hotplug_fd != -1 && inotify_add_watch(hotplug_fd, "/dev/input",
+		    IN_CREATE | IN_ATTRIB | IN_DELETE) == -1) {
+			perror("in_evdev: inotify_add_watch");
+			close(hotplug_fd);
+			hotplug_fd = -1;
+		}
+	}
+
+	// nodes may have holes after unplugs, open all of them,
+	// in order so that device numbering stays the same
+	dir = opendir("/dev/input");
+	if (dir == NULL)
+		return;
+	while ((ent = readdir(dir)) != NULL) {
+		if (sscanf(ent->d_name, "event%d", &n) == 1 && n > max)
+			max = n;
 	}
+	closedir(dir);
+
+	for (i = 0; i <= max; i++)
+		in_evdev_open(i);
 }
 
 static void in_evdev_free(void *drv_data)
 {
-	in_evdev_t *dev = drv_data;
+	in_evdev_t *dev = drv_data, **pp;
 	if (dev == NULL)
 		return;
+	for (pp = &dev_list; *pp != NULL; pp = &(*pp)->next) {
+		if (*pp == dev) {
+			*pp = dev->next;
+			break;
+		}
+	}
 	close(dev->fd);
 	free(dev);
 }
 
+static in_evdev_t *in_evdev_find(int node)
+{
+	in_evdev_t *dev;
+	for (dev = dev_list; dev != NULL; dev = dev->next)
+		if (dev->node == node)
+			return dev;
+	return NULL;
+}
+
+/* open new nodes and drop removed ones, leaving the rest alone.
+ * udev may only fix the node permissions after creating it,
+ * so an IN_ATTRIB change is another chance to open it */
+static void in_evdev_hotplug(void)
+{
+	char buf[4096] __attribute__((aligned(__alignof__(struct inotify_event))));
+	const struct inotify_event *ie;
+	in_evdev_t *dev;
+	int len, node;
+	char *p;
+
+	if (hotplug_fd == -1)
+		return;
+
+	while ((len = read(hotplug_fd, buf, sizeof(buf))) > 0) {
+		for (p = buf; p < buf + len; p += sizeof(*ie) + ie->len) {
+			ie = (const struct inotify_event *)p;
+			if (ie->len == 0 || sscanf(ie->name, "event%d", &node) != 1)
+				continue;
+
+			dev = in_evdev_find(node);
+			if (ie->mask & IN_DELETE) {
+				if (dev != NULL)
+					in_unregister(dev);
+			}
+			else if (dev == NULL)
+				in_evdev_open(node);
+		}
+	}
+}
+
+static int in_evdev_get_hotplug_fd(void)
+{
+	return hotplug_fd;
+}
+
 static const char * const *
 in_evdev_get_key_names(int *count)
 {
@@ -292,88 +462,52 @@ in_evdev_get_key_names(int *count)
 	return in_evdev_keys;
 }
 
-static void or_binds(const int *binds, int key, int *result)
-{
-	int t;
-	for (t = 0; t < IN_BINDTYPE_COUNT; t++)
-		result[t] |= binds[IN_BIND_OFFS(key, t)];
-}
-
-/* ORs result with binds of pressed buttons
- * XXX: should measure performance hit of this func, might need to optimize */
-static int in_evdev_update(void *drv_data, const int *binds, int *result)
+/* sets keybits of pressed buttons, input.c maps them through binds;
+ * state comes from the event stream, no ioctls unless events were lost */
+static int in_evdev_update_keybits(void *drv_data, uint32_t *keybits_out, int words)
 {
-	struct input_event ev[16];
-	struct input_absinfo ainfo;
-	int keybits_[KEY_CNT / sizeof(int)];
-	int *keybits = keybits_;
+	int *keybits;
 	in_evdev_t *dev = drv_data;
-	int rd, ret, u, lzone;
+	int lzone, full = 1;
+	size_t size = words * sizeof(keybits_out[0]);
 
-	if (dev->kbits == NULL) {
-		ret = ioctl(dev->fd, EVIOCGKEY(sizeof(keybits_)), keybits_);
-		if (ret == -1) {
-			perror("in_evdev: ioctl failed");
-			return -1;
-		}
-	}
-	else {
-		keybits = dev->kbits;
-		while (1) {
-			rd = read(dev->fd, ev, sizeof(ev));
-			if (rd < (int)sizeof(ev[0])) {
-				if (errno != EAGAIN)
-					perror("in_evdev: read failed");
-				break;
-			}
-			for (u = 0; u < rd / sizeof(ev[0]); u++) {
-				if (ev[u].type != EV_KEY)
-					continue;
-				else if (ev[u].value == 1)
-					KEYBITS_BIT_SET(ev[u].code);
-				else if (ev[u].value == 0)
-					KEYBITS_BIT_CLEAR(ev[u].code);
-			}
-		}
-	}
+	if (size > sizeof(dev->kbits))
+		size = sizeof(dev->kbits);
+
+	while (1) {
+		while (dev->evbuf_pos < dev->evbuf_cnt)
+			in_evdev_track(dev, &dev->evbuf[dev->evbuf_pos++]);
 
-	for (u = dev->kc_first; u <= dev->kc_last; u++) {
-		if (KEYBITS_BIT(u))
-			or_binds(binds, u, result);
+		/* a short read means the queue is empty; can't drain in
+		 * blocking mode, the cached state will do */
+		if (!full || dev->blocking || in_evdev_read(dev) <= 0)
+			break;
+		full = dev->evbuf_cnt == sizeof(dev->evbuf) / sizeof(dev->evbuf[0]);
 	}
+	memcpy(keybits_out, dev->kbits, size);
 
 	/* map X and Y absolute to UDLR */
+	keybits = (int *)keybits_out;
 	lzone = dev->abs_lzone;
 	if (dev->abs_to_digital && lzone != 0) {
-		ret = ioctl(dev->fd, EVIOCGABS(ABS_X), &ainfo);
-		if (ret != -1) {
-			if (ainfo.value < dev->abs_min_x + lzone) or_binds(binds, KEY_LEFT, result);
-			if (ainfo.value > dev->abs_max_x - lzone) or_binds(binds, KEY_RIGHT, result);
-		}
-		ret = ioctl(dev->fd, EVIOCGABS(ABS_Y), &ainfo);
-		if (ret != -1) {
-			if (ainfo.value < dev->abs_min_y + lzone) or_binds(binds, KEY_UP, result);
-			if (ainfo.value > dev->abs_max_y - lzone) or_binds(binds, KEY_DOWN, result);
-		}
+		if (dev->abs_val[ABS_X] < dev->abs_min_x + lzone) KEYBITS_BIT_SET(KEY_LEFT);
+		if (dev->abs_val[ABS_X] > dev->abs_max_x - lzone) KEYBITS_BIT_SET(KEY_RIGHT);
+		if (dev->abs_val[ABS_Y] < dev->abs_min_y + lzone) KEYBITS_BIT_SET(KEY_UP);
+		if (dev->abs_val[ABS_Y] > dev->abs_max_y - lzone) KEYBITS_BIT_SET(KEY_DOWN);
 	}
 
 	return 0;
 }
 
+/* served from the values tracked by update_keybits/update_keycode */
 static int in_evdev_update_analog(void *drv_data, int axis_id, int *result)
 {
-	struct input_absinfo ainfo;
 	in_evdev_t *dev = drv_data;
-	int ret;
 
-	if ((unsigned int)axis_id >= MAX_ABS_DEVS)
+	if ((unsigned int)axis_id >= dev->abs_count)
 		return -1;
 
-	ret = ioctl(dev->fd, EVIOCGABS(axis_id), &ainfo);
-	if (ret != 0)
-		return ret;
-
-	*result = (ainfo.value + dev->abs_adj[axis_id]) * dev->abs_mult[axis_id];
+	*result = (dev->abs_val[axis_id] + dev->abs_adj[axis_id]) * dev->abs_mult[axis_id];
 	*result >>= 16;
 	return 0;
 }
@@ -396,6 +530,8 @@ static int in_evdev_set_blocking(in_evdev_t *dev, int y)
 			ret = read(dev->fd, &ev, sizeof(ev));
 		}
 		while (ret == sizeof(ev));
+		dev->evbuf_pos = dev->evbuf_cnt = 0;
+		in_evdev_resync(dev);
 	}
 
 	if (y)
@@ -407,6 +543,7 @@ static int in_evdev_set_blocking(in_evdev_t *dev, int y)
 		perror("in_evdev: F_SETFL fcntl failed");
 		return -1;
 	}
+	dev->blocking = !!y;
 
 	return 0;
 }
@@ -452,48 +589,35 @@ static int in_evdev_set_config(void *drv_data, int what, int val)
 	return 0;
 }
 
-static int in_evdev_update_keycode(void *data, int *is_down)
+/* keycode for one event, -1 if it doesn't make a key event */
+static int in_evdev_decode(in_evdev_t *dev, const struct input_event *ev,
+	int *is_down)
 {
 	int ret_kc = -1, ret_down = 0;
-	in_evdev_t *dev = data;
-	struct input_event ev;
-	int rd;
 
-	/* do single event, the caller sometimes wants
-	 * to do select() in blocking mode */
-	rd = read(dev->fd, &ev, sizeof(ev));
-	if (rd < (int) sizeof(ev)) {
-		if (errno != EAGAIN) {
-			perror("in_evdev: error reading");
-			//sleep(1);
-			ret_kc = -2;
-		}
-		goto out;
-	}
-
-	if (ev.type == EV_KEY) {
-		if (ev.value < 0 || ev.value > 1)
+	if (ev->type == EV_KEY) {
+		if (ev->value < 0 || ev->value > 1)
 			goto out;
-		ret_kc = ev.code;
-		ret_down = ev.value;
+		ret_kc = ev->code;
+		ret_down = ev->value;
 		goto out;
 	}
-	else if (ev.type == EV_ABS && dev->abs_to_digital)
+	else if (ev->type == EV_ABS && dev->abs_to_digital)
 	{
 		int lzone = dev->abs_lzone, down = 0, *last;
 
 		// map absolute to up/down/left/right
-		if (lzone != 0 && ev.code == ABS_X) {
-			if (ev.value < dev->abs_min_x + lzone)
+		if (lzone != 0 && ev->code == ABS_X) {
+			if (ev->value < dev->abs_min_x + lzone)
 				down = KEY_LEFT;
-			else if (ev.value > dev->abs_max_x - lzone)
+			else if (ev->value > dev->abs_max_x - lzone)
 				down = KEY_RIGHT;
 			last = &dev->abs_lastx;
 		}
-		else if (lzone != 0 && ev.code == ABS_Y) {
-			if (ev.value < dev->abs_min_y + lzone)
+		else if (lzone != 0 && ev->code == ABS_Y) {
+			if (ev->value < dev->abs_min_y + lzone)
 				down = KEY_UP;
-			else if (ev.value > dev->abs_max_y - lzone)
+			else if (ev->value > dev->abs_max_y - lzone)
 				down = KEY_DOWN;
 			last = &dev->abs_lasty;
 		}
@@ -516,12 +640,66 @@ static int in_evdev_update_keycode(void *data, int *is_down)
 	}
 
 out:
+	*is_down = ret_down;
+	return ret_kc;
+}
+
+static int in_evdev_update_keycode_ts(void *data, int *is_down, uint64_t *time_ns)
+{
+	int ret_kc = -1, ret_down = 0;
+	in_evdev_t *dev = data;
+	struct input_event *ev;
+	int may_read;
+
+	/* read only if nothing was buffered, the caller sometimes
+	 * wants to do select() in blocking mode and then call us once */
+	may_read = dev->evbuf_pos == dev->evbuf_cnt;
+
+	while (1) {
+		if (dev->evbuf_pos == dev->evbuf_cnt) {
+			if (!may_read)
+				break;
+			may_read = 0;
+			if (in_evdev_read(dev) < 0) {
+				ret_kc = -2;
+				break;
+			}
+			continue;
+		}
+
+		ev = &dev->evbuf[dev->evbuf_pos++];
+		in_evdev_track(dev, ev);
+		ret_kc = in_evdev_decode(dev, ev, &ret_down);
+		if (ret_kc < 0)
+			continue;
+
+		if (time_ns != NULL) {
+			if (dev->ts_monotonic)
+				*time_ns = (uint64_t)ev->input_event_sec * 1000000000
+					+ (uint64_t)ev->input_event_usec * 1000;
+			else
+				*time_ns = plat_get_ticks_ns();
+		}
+		break;
+	}
+
 	if (is_down != NULL)
 		*is_down = ret_down;
 
 	return ret_kc;
 }
 
+static int in_evdev_pending(void *drv_data)
+{
+	in_evdev_t *dev = drv_data;
+	return dev->evbuf_pos < dev->evbuf_cnt;
+}
+
+static int in_evdev_update_keycode(void *data, int *is_down)
+{
+	return in_evdev_update_keycode_ts(data, is_down, NULL);
+}
+
 static const struct {
 	short key;
 	short pbtn;
@@ -638,14 +816,18 @@ static int in_evdev_clean_binds(void *drv_data, int *binds, int *def_binds)
 static const in_drv_t in_evdev_drv = {
 	.prefix         = IN_EVDEV_PREFIX,
 	.probe          = in_evdev_probe,
+	.hotplug        = in_evdev_hotplug,
+	.get_hotplug_fd = in_evdev_get_hotplug_fd,
 	.free           = in_evdev_free,
 	.get_key_names  = in_evdev_get_key_names,
 	.clean_binds    = in_evdev_clean_binds,
 	.get_config     = in_evdev_get_config,
 	.set_config     = in_evdev_set_config,
-	.update         = in_evdev_update,
+	.update_keybits = in_evdev_update_keybits,
 	.update_analog  = in_evdev_update_analog,
 	.update_keycode = in_evdev_update_keycode,
+	.update_keycode_ts = in_evdev_update_keycode_ts,
+	.pending        = in_evdev_pending,
 	.menu_translate = in_evdev_menu_translate,
 };
 
@@ -0,0 +1,210 @@
+/*
+ * W^X code cache, memfd mapped RW + RX
+ *
+ * This work is licensed under the terms of any of these licenses
+ * (at your option):
+ *  - GNU GPL, version 2 or later.
+ *  - GNU LGPL, version 2.1 or later.
+ *  - MAME license.
+ * See the COPYING file in the top-level directory.
+ */
+
+#define _GNU_SOURCE 1
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <errno.h>
+#include <sys/mman.h>
+#include <sys/syscall.h>
+
+#include "jit_cache.h"
+
+#ifndef MFD_CLOEXEC
+#define MFD_CLOEXEC 1
+#endif
+
+struct jit_cache {
+	char *rx;
+	char *rw;
+	size_t size;
+	size_t arena_size;
+	int fd;				/* -1 for RWX */
+	int arena;			/* arena being filled */
+	size_t pos;			/* bump offset in it */
+	size_t live[JIT_CACHE_ARENAS];	/* bytes not freed yet */
+	jit_cache_evict_cb *evict_cb;
+	void *cb_arg;
+};
+
+static int memfd(const char *name)
+{
+#ifdef __NR_memfd_create
+	return syscall(__NR_memfd_create, name, MFD_CLOEXEC);
+#else
+	errno = ENOSYS;
+	return -1;
+#endif
+}
+
+static int map_dual(struct jit_cache *jc, unsigned long rx_addr)
+{
+	void *rx, *rw;
+	int fd;
+
+	fd = memfd("jit_cache");
+	if (fd < 0)
+		return -1;
+	if (ftruncate(fd, jc->size) != 0)
+		goto fail;
+
+	rx = mmap((void *)rx_addr, jc->size, PROT_READ | PROT_EXEC,
+		MAP_SHARED, fd, 0);
+	if (rx == MAP_FAILED)
+		goto fail;
+	rw = mmap(NULL, jc->size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+	if (rw == MAP_FAILED) {
+		munmap(rx, jc->size);
+		goto fail;
+	}
+
+	jc->fd = fd;
+	jc->rx = rx;
+	jc->rw = rw;
+	return 0;
+
+fail:
+	close(fd);
+	return -1;
+}
+
+struct jit_cache *jit_cache_init(size_t size, unsigned long rx_addr,
+				 jit_cache_evict_cb *evict_cb, void *cb_arg)
+{
+	size_t unit = sysconf(_SC_PAGESIZE) * JIT_CACHE_ARENAS;
+	struct jit_cache *jc;
+	void *rwx;
+
+	jc = calloc(1, sizeof(*jc));
+	if (jc == NULL)
+		return NULL;
+
+	jc->size = (size + unit - 1) / unit * unit;
+	jc->arena_size = jc->size / JIT_CACHE_ARENAS;
+	jc->evict_cb = evict_cb;
+	jc->cb_arg = cb_arg;
+
+	if (map_dual(jc, rx_addr) != 0) {
+		fprintf(stderr, "jit_cache: dual mapping failed (%d), "
+			"using RWX\n", errno);
+		rwx = mmap((void *)rx_addr, jc->size,
+			PROT_READ | PROT_WRITE | PROT_EXEC,
+			MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+		if (rwx == MAP_FAILED) {
+			perror("jit_cache: mmap");
+			free(jc);
+			return NULL;
+		}
+		jc->fd = -1;
+		jc->rx = jc->rw = rwx;
+	}
+
+	if (rx_addr != 0 && jc->rx != (char *)rx_addr)
+		fprintf(stderr, "jit_cache: warning: RX at %p, requested %p\n",
+			jc->rx, (void *)rx_addr);
+
+	return jc;
+}
+
+void jit_cache_finish(struct jit_cache *jc)
+{
+	if (jc == NULL)
+		return;
+
+	munmap(jc->rx, jc->size);
+	if (jc->fd >= 0) {
+		munmap(jc->rw, jc->size);
+		close(jc->fd);
+	}
+	free(jc);
+}
+
+void *jit_cache_alloc(struct jit_cache *jc, size_t size)
+{
+	char *arena_rx;
+	void *ret;
+
+	size = (size + JIT_CACHE_ALIGN - 1) & ~(JIT_CACHE_ALIGN - 1);
+	if (size > jc->arena_size)
+		return NULL;
+
+	if (jc->pos + size > jc->arena_size) {
+		jc->arena = (jc->arena + 1) % JIT_CACHE_ARENAS;
+		jc->pos = 0;
+		if (jc->live[jc->arena] != 0) {
+			arena_rx = jc->rx + jc->arena * jc->arena_size;
+			if (jc->evict_cb != NULL)
+				jc->evict_cb(jc->cb_arg, arena_rx,
+					arena_rx + jc->arena_size);
+			jc->live[jc->arena] = 0;
+		}
+	}
+
+	ret = jc->rw + jc->arena * jc->arena_size + jc->pos;
+	jc->pos += size;
+	jc->live[jc->arena] += size;
+
+	return ret;
+}
+
+void jit_cache_free(struct jit_cache *jc, void *rw, size_t size)
+{
+	int arena = ((char *)rw - jc->rw) / jc->arena_size;
+	size_t offs = ((char *)rw - jc->rw) % jc->arena_size;
+
+	size = (size + JIT_CACHE_ALIGN - 1) & ~(JIT_CACHE_ALIGN - 1);
+	// only catches stale frees past the fill point, see jit_cache.h
+	if (jc->live[arena] < size
+	    || (arena == jc->arena && offs + size > jc->pos)) {
+		fprintf(stderr, "jit_cache: bad free %p %zu\n", rw, size);
+		return;
+	}
+
+	jc->live[arena] -= size;
+	if (jc->live[arena] == 0 && arena == jc->arena)
+		jc->pos = 0;
+}
+
+void jit_cache_reset(struct jit_cache *jc)
+{
+	memset(jc->live, 0, sizeof(jc->live));
+	jc->arena = 0;
+	jc->pos = 0;
+}
+
+void jit_cache_commit(struct jit_cache *jc, void *rw, size_t size)
+{
+	char *rx = jit_cache_rx(jc, rw);
+
+	// with two views, a virtually indexed dcache (ARMv5) may hold the
+	// code under the RW address only, so write back that range too;
+	// the builtin is a no-op on x86 and the cacheflush syscall on ARM
+	if (jc->fd >= 0)
+		__builtin___clear_cache((char *)rw, (char *)rw + size);
+	__builtin___clear_cache(rx, rx + size);
+}
+
+void *jit_cache_rx(struct jit_cache *jc, const void *rw)
+{
+	return jc->rx + ((const char *)rw - jc->rw);
+}
+
+void *jit_cache_rw(struct jit_cache *jc, const void *rx)
+{
+	return jc->rw + ((const char *)rx - jc->rx);
+}
+
+int jit_cache_is_dual(struct jit_cache *jc)
+{
+	return jc->fd >= 0;
+}
@@ -0,0 +1,42 @@
+#include <stddef.h>
+
+/*
+ * Code cache for dynarecs that works where RWX mappings are not
+ * allowed: the same memfd is mapped twice, code is written through
+ * the RW view and run from the RX view, rx = rw - offset.
+ * Falls back to a single RWX mapping when memfd is not available.
+ *
+ * Space is handed out by bumping through JIT_CACHE_ARENAS arenas in
+ * a ring; when the ring comes around to an arena that still holds
+ * live blocks, evict_cb is called for it first so that the caller
+ * can drop them from its lookup tables. Blocks in the evicted range
+ * (or all of them after jit_cache_reset()) are gone at that point and
+ * must not be passed to jit_cache_free(): their space already belongs
+ * to new blocks, and a stale free would be charged to those.
+ */
+#define JIT_CACHE_ARENAS	8
+#define JIT_CACHE_ALIGN		16
+
+struct jit_cache;
+
+typedef void (jit_cache_evict_cb)(void *arg, void *rx_start, void *rx_end);
+
+/* rx_addr is a hint for the RX view (for branch range), may be 0 */
+struct jit_cache *jit_cache_init(size_t size, unsigned long rx_addr,
+				 jit_cache_evict_cb *evict_cb, void *cb_arg);
+void  jit_cache_finish(struct jit_cache *jc);
+
+/* returns the RW address to emit to, NULL if size exceeds an arena */
+void *jit_cache_alloc(struct jit_cache *jc, size_t size);
+/* block invalidation; space is reused once its arena has no live blocks */
+void  jit_cache_free(struct jit_cache *jc, void *rw, size_t size);
+/* drop everything without calling evict_cb */
+void  jit_cache_reset(struct jit_cache *jc);
+
+/* make freshly written code visible to the RX view (icache flush) */
+void  jit_cache_commit(struct jit_cache *jc, void *rw, size_t size);
+
+void *jit_cache_rx(struct jit_cache *jc, const void *rw);
+void *jit_cache_rw(struct jit_cache *jc, const void *rx);
+/* 1 if RW and RX are separate views, 0 if running on an RWX mapping */
+int   jit_cache_is_dual(struct jit_cache *jc);
@@ -18,6 +18,9 @@
 #include <time.h>
 #include <unistd.h>
 #include <sys/mman.h>
+#include <sys/epoll.h>
+#include <sys/timerfd.h>
+#include <sys/eventfd.h>
 #include <errno.h>
 
 #include "../plat.h"
@@ -28,6 +31,12 @@
 #ifndef MAP_HUGETLB
 #define MAP_HUGETLB 0x40000 /* arch specific */
 #endif
+#ifndef MADV_HUGEPAGE
+#define MADV_HUGEPAGE 14
+#endif
+#ifndef MADV_POPULATE_WRITE
+#define MADV_POPULATE_WRITE 23
+#endif
 
 
 int plat_is_dir(const char *path)
@@ -66,33 +75,43 @@ int plat_get_root_dir(char *dst, int len)
 #define plat_get_ticks_us plat_get_ticks_us_good
 #endif
 
+/* gettimeofday() steps with settimeofday/NTP, use the monotonic clock
+ * (vDSO, no syscall) for everything */
 unsigned int plat_get_ticks_ms(void)
 {
-	struct timeval tv;
+	struct timespec ts;
 	unsigned int ret;
 
-	gettimeofday(&tv, NULL);
+	clock_gettime(CLOCK_MONOTONIC, &ts);
 
-	ret = (unsigned)tv.tv_sec * 1000;
-	/* approximate /= 1000 */
-	ret += ((unsigned)tv.tv_usec * 4195) >> 22;
+	ret = (unsigned)ts.tv_sec * 1000;
+	ret += (unsigned)ts.tv_nsec / 1000000;
 
 	return ret;
 }
 
 unsigned int plat_get_ticks_us(void)
 {
-	struct timeval tv;
+	struct timespec ts;
 	unsigned int ret;
 
-	gettimeofday(&tv, NULL);
+	clock_gettime(CLOCK_MONOTONIC, &ts);
 
-	ret = (unsigned)tv.tv_sec * 1000000;
-	ret += (unsigned)tv.tv_usec;
+	ret = (unsigned)ts.tv_sec * 1000000;
+	ret += (unsigned)ts.tv_nsec / 1000;
 
 	return ret;
 }
 
+uint64_t plat_get_ticks_ns(void)
+{
+	struct timespec ts;
+
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+
+	return (uint64_t)ts.tv_sec * 1000000000 + ts.tv_nsec;
+}
+
 void plat_sleep_ms(int ms)
 {
 	usleep(ms * 1000);
@@ -119,6 +138,8 @@ int plat_wait_event(int *fds_hnds, int count, int timeout_ms)
 	ret = select(fdmax + 1, &fdset, NULL, NULL, timeout);
 	if (ret == -1)
 	{
+		if (errno == EINTR)
+			return -1;
 		perror("plat_wait_event: select failed");
 		sleep(1);
 		return -1;
@@ -135,53 +156,253 @@ int plat_wait_event(int *fds_hnds, int count, int timeout_ms)
 	return ret;
 }
 
-void *plat_mmap(unsigned long addr, size_t size, int need_exec, int is_fixed)
+static void mmap_populate(void *ptr, size_t size)
+{
+	long pagesize = sysconf(_SC_PAGESIZE);
+	volatile char *p = ptr;
+	size_t i;
+
+	if (madvise(ptr, size, MADV_POPULATE_WRITE) == 0)
+		return;
+
+	// older kernel, fault the pages in by hand
+	for (i = 0; i < size; i += pagesize)
+		p[i] = p[i];
+}
+
+/* overmap and trim, so that the whole range can use huge pages */
+static void *mmap_aligned(size_t size, int prot, int flags)
+{
+	size_t align = HUGETLB_PAGESIZE;
+	size_t page = sysconf(_SC_PAGESIZE);
+	char *ret, *aligned;
+
+	// the tail munmap needs a page aligned start
+	size = (size + page - 1) & ~(page - 1);
+	ret = mmap(NULL, size + align, prot, flags, -1, 0);
+	if (ret == MAP_FAILED)
+		return ret;
+
+	aligned = (char *)(((unsigned long)ret + align - 1) & ~(align - 1));
+	if (aligned != ret)
+		munmap(ret, aligned - ret);
+	munmap(aligned + size, ret + align - aligned);
+
+	return aligned;
+}
+
+struct plat_wait_set {
+	int epfd;
+	int timerfd;		/* CLOCK_MONOTONIC, for deadlines */
+	int eventfd;		/* for plat_wait_set_wake() */
+	int timer_armed;
+};
+
+struct plat_wait_set *plat_wait_set_create(void)
+{
+	struct plat_wait_set *ws;
+
+	ws = calloc(1, sizeof(*ws));
+	if (ws == NULL)
+		return NULL;
+
+	ws->epfd = epoll_create1(EPOLL_CLOEXEC);
+	ws->timerfd = timerfd_create(CLOCK_MONOTONIC, TFD_NONBLOCK | TFD_CLOEXEC);
+	ws->eventfd = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+	if (ws->epfd == -1 || ws->timerfd == -1 || ws->eventfd == -1
+	    || plat_wait_set_add(ws, ws->timerfd) != 0
+	    || plat_wait_set_add(ws, ws->eventfd) != 0)
+	{
+		perror("plat_wait_set_create");
+		plat_wait_set_destroy(ws);
+		return NULL;
+	}
+
+	return ws;
+}
+
+int plat_wait_set_add(struct plat_wait_set *ws, int fd_hnd)
+{
+	struct epoll_event ev;
+
+	memset(&ev, 0, sizeof(ev));
+	ev.events = EPOLLIN;
+	ev.data.fd = fd_hnd;
+	if (epoll_ctl(ws->epfd, EPOLL_CTL_ADD, fd_hnd, &ev) != 0) {
+		perror("plat_wait_set_add");
+		return -1;
+	}
+
+	return 0;
+}
+
+int plat_wait_set_remove(struct plat_wait_set *ws, int fd_hnd)
+{
+	struct epoll_event ev;
+
+	// old kernels want a non-NULL event even for DEL
+	if (epoll_ctl(ws->epfd, EPOLL_CTL_DEL, fd_hnd, &ev) != 0)
+		return -1;
+
+	return 0;
+}
+
+int plat_wait_set_wait(struct plat_wait_set *ws, int *ready, int max,
+		       uint64_t deadline_ns)
+{
+	struct epoll_event ev[16];
+	struct itimerspec its;
+	uint64_t val;
+	int i, n, fd, ret = 0;
+
+	memset(&its, 0, sizeof(its));
+	if (deadline_ns != PLAT_WAIT_FOREVER) {
+		its.it_value.tv_sec = deadline_ns / 1000000000;
+		its.it_value.tv_nsec = deadline_ns % 1000000000;
+		if (deadline_ns == 0)
+			its.it_value.tv_nsec = 1; // 0 would disarm
+		timerfd_settime(ws->timerfd, TFD_TIMER_ABSTIME, &its, NULL);
+		ws->timer_armed = 1;
+	}
+	else if (ws->timer_armed) {
+		timerfd_settime(ws->timerfd, 0, &its, NULL);
+		ws->timer_armed = 0;
+	}
+
+	n = epoll_wait(ws->epfd, ev, sizeof(ev) / sizeof(ev[0]), -1);
+	if (n == -1) {
+		if (errno == EINTR)
+			return 0;
+		perror("plat_wait_set_wait: epoll_wait failed");
+		return -1;
+	}
+
+	for (i = 0; i < n; i++) {
+		fd = ev[i].data.fd;
+		if (fd != ws->timerfd && fd != ws->eventfd) {
+			if (ret < max)
+				ready[ret++] = fd;
+		}
+		else if (read(fd, &val, sizeof(val)) < 0 && errno != EAGAIN)
+			perror("plat_wait_set_wait: read");
+	}
+
+	return ret;
+}
+
+void plat_wait_set_wake(struct plat_wait_set *ws)
+{
+	uint64_t val = 1;
+
+	if (write(ws->eventfd, &val, sizeof(val)) < 0)
+		perror("plat_wait_set_wake");
+}
+
+void plat_wait_set_destroy(struct plat_wait_set *ws)
+{
+	if (ws == NULL)
+		return;
+
+	if (ws->epfd != -1)
+		close(ws->epfd);
+	if (ws->timerfd != -1)
+		close(ws->timerfd);
+	if (ws->eventfd != -1)
+		close(ws->eventfd);
+	free(ws);
+}
+
+void *plat_mmap_ext(unsigned long addr, size_t size, int pflags, int *got)
 {
 	static int hugetlb_disabled;
 	int prot = PROT_READ | PROT_WRITE;
 	int flags = MAP_PRIVATE | MAP_ANONYMOUS;
-	void *req, *ret;
+	int obtained = pflags & (PLAT_MMAP_EXEC | PLAT_MMAP_FIXED);
+	void *req, *ret = MAP_FAILED;
 
 	req = (void *)addr;
-	if (need_exec)
+	if (pflags & PLAT_MMAP_EXEC)
 		prot |= PROT_EXEC;
-	if (is_fixed)
+	if (pflags & PLAT_MMAP_FIXED)
 		flags |= MAP_FIXED;
-	//if (size >= HUGETLB_THRESHOLD && !hugetlb_disabled)
-		//flags |= MAP_HUGETLB;
 
-	ret = mmap(req, size, prot, flags, -1, 0);
-	if (ret == MAP_FAILED && (flags & MAP_HUGETLB)) {
-		fprintf(stderr,
-			"warning: failed to do hugetlb mmap (%p, %zu): %d\n",
-			req, size, errno);
-		hugetlb_disabled = 1;
-		flags &= ~MAP_HUGETLB;
-		ret = mmap(req, size, prot, flags, -1, 0);
+	if ((pflags & PLAT_MMAP_HUGETLB) && size >= HUGETLB_THRESHOLD
+	    && !hugetlb_disabled && (addr & (HUGETLB_PAGESIZE - 1)) == 0)
+	{
+		ret = mmap(req, size, prot, flags | MAP_HUGETLB, -1, 0);
+		if (ret == MAP_FAILED) {
+			// usually no pages reserved in /proc/sys/vm/nr_hugepages
+			fprintf(stderr,
+				"warning: failed to do hugetlb mmap (%p, %zu): %d\n",
+				req, size, errno);
+			hugetlb_disabled = 1;
+		}
+		else
+			obtained |= PLAT_MMAP_HUGETLB;
 	}
+
+	if (ret == MAP_FAILED && (pflags & PLAT_MMAP_THP)
+	    && size >= HUGETLB_PAGESIZE && req == NULL)
+		ret = mmap_aligned(size, prot, flags);
+	if (ret == MAP_FAILED)
+		ret = mmap(req, size, prot, flags, -1, 0);
 	if (ret == MAP_FAILED)
 		return NULL;
 
+	if (!(obtained & PLAT_MMAP_HUGETLB) && (pflags & PLAT_MMAP_THP)
+	    && size >= HUGETLB_PAGESIZE
+	    && madvise(ret, size, MADV_HUGEPAGE) == 0)
+		obtained |= PLAT_MMAP_THP;
+
+	if (pflags & PLAT_MMAP_POPULATE) {
+		mmap_populate(ret, size);
+		obtained |= PLAT_MMAP_POPULATE;
+	}
+
 	if (req != NULL && ret != req)
 		fprintf(stderr,
 			"warning: mmaped to %p, requested %p\n", ret, req);
 
+	if (got != NULL)
+		*got = obtained;
 	return ret;
 }
 
+void *plat_mmap(unsigned long addr, size_t size, int need_exec, int is_fixed)
+{
+	int flags = PLAT_MMAP_THP;
+
+	if (need_exec)
+		flags |= PLAT_MMAP_EXEC;
+	if (is_fixed)
+		flags |= PLAT_MMAP_FIXED;
+
+	return plat_mmap_ext(addr, size, flags, NULL);
+}
+
 void *plat_mremap(void *ptr, size_t oldsize, size_t newsize)
 {
-	/*
 	void *ret;
 
+	// grows in place when there's room, huge page advice carries over
 	ret = mremap(ptr, oldsize, newsize, MREMAP_MAYMOVE);
-	if (ret == MAP_FAILED)
+	if (ret == MAP_FAILED && errno == EINVAL
+	    && ((oldsize | newsize) & (HUGETLB_PAGESIZE - 1))) {
+		// perhaps a hugetlb mapping, those need whole pages
+		oldsize = (oldsize + HUGETLB_PAGESIZE - 1) & ~(HUGETLB_PAGESIZE - 1);
+		newsize = (newsize + HUGETLB_PAGESIZE - 1) & ~(HUGETLB_PAGESIZE - 1);
+		ret = mremap(ptr, oldsize, newsize, MREMAP_MAYMOVE);
+	}
+	if (ret == MAP_FAILED) {
+		fprintf(stderr,
+			"mremap(%p, %zu, %zu) failed: %d\n", ptr, oldsize, newsize, errno);
 		return NULL;
+	}
 	if (ret != ptr)
-		printf("warning: mremap moved: %p -> %p\n", ptr, ret);
+		fprintf(stderr,
+			"warning: mremap moved: %p -> %p\n", ptr, ret);
 
 	return ret;
-	*/
 }
 
 void plat_munmap(void *ptr, size_t size)
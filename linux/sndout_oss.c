@@ -116,7 +116,7 @@ int sndout_oss_write(const void *buff, int len)
 int sndout_oss_write_nb(const void *buff, int len)
 {
 	static int lag_counter, skip_counter;
-	unsigned int t;
+	uint64_t t;
 	int ret;
 
 	if (lag_counter > 2) {
@@ -130,14 +130,14 @@ int sndout_oss_write_nb(const void *buff, int len)
 		return len;
 	}
 
-	t = plat_get_ticks_ms();
+	t = plat_get_ticks_ns();
 	ret = sndout_oss_write(buff, len);
-	t = plat_get_ticks_ms() - t;
-	if (t > 1) {
+	t = plat_get_ticks_ns() - t;
+	if (t > 1000000) {
 		// this shouldn't really happen, most likely audio is out of sync
 		lag_counter++;
 		if (lag_counter > 2)
-			printf("audio lag %u\n", t);
+			printf("audio lag %uus\n", (unsigned int)(t / 1000));
 	}
 	else
 		lag_counter = 0;
@@ -23,6 +23,7 @@
 #include "input.h"
 #include "plat.h"
 #include "posix.h"
+#include "pixops.h"
 
 static char static_buff[64];
 static int  menu_error_time = 0;
@@ -339,25 +340,7 @@ void menu_init_base(void)
 
 static void menu_darken_bg(void *dst, void *src, int pixels, int darker)
 {
-	unsigned int *dest = dst;
-	unsigned int *sorc = src;
-	pixels /= 2;
-	if (darker)
-	{
-		while (pixels--)
-		{
-			unsigned int p = *sorc++;
-			*dest++ = ((p&0xf79ef79e)>>1) - ((p&0xc618c618)>>3);
-		}
-	}
-	else
-	{
-		while (pixels--)
-		{
-			unsigned int p = *sorc++;
-			*dest++ = (p&0xf79ef79e)>>1;
-		}
-	}
+	pixops.darken_bg(dst, src, pixels, darker);
 }
 
 static void menu_darken_text_bg(void)
@@ -19,6 +19,7 @@
 
 #include "../plat.h"
 #include "../input.h"
+#include "../pixops.h"
 
 static const char * const pandora_gpio_keys[KEY_MAX + 1] = {
 	[0 ... KEY_MAX] = NULL,
@@ -216,6 +217,7 @@ struct plat_target plat_target = {
 int plat_target_init(void)
 {
 	scan_for_filters();
+	pixops_init();
 
 	return 0;
 }
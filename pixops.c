@@ -0,0 +1,111 @@
+/*
+ * pixel kernel dispatch, C versions
+ *
+ * This work is licensed under the terms of any of these licenses
+ * (at your option):
+ *  - GNU GPL, version 2 or later.
+ *  - GNU LGPL, version 2.1 or later.
+ *  - MAME license.
+ * See the COPYING file in the top-level directory.
+ */
+
+#include <stdio.h>
+#include <string.h>
+#if defined(__linux__) && defined(__arm__)
+#include <sys/auxv.h>
+#endif
+
+#include "pixops.h"
+#include "filters.h"
+
+#ifndef HWCAP_NEON
+#define HWCAP_NEON (1 << 12)	/* arm32 AT_HWCAP bit */
+#endif
+
+unsigned int pixops_cpu_features(void)
+{
+	static unsigned int features = ~0u;
+
+	if (features != ~0u)
+		return features;
+
+	features = 0;
+#if defined(__i386__) || defined(__x86_64__)
+	__builtin_cpu_init();
+	if (__builtin_cpu_supports("sse2"))
+		features |= PIXOPS_CPU_SSE2;
+	if (__builtin_cpu_supports("avx2"))
+		features |= PIXOPS_CPU_AVX2;
+#elif defined(__aarch64__)
+	features |= PIXOPS_CPU_NEON;	/* always there */
+#elif defined(__arm__) && defined(__linux__)
+	if (getauxval(AT_HWCAP) & HWCAP_NEON)
+		features |= PIXOPS_CPU_NEON;
+#endif
+
+	return features;
+}
+
+void pixops_darken_bg_c(void *dst, const void *src, int pixels, int darker)
+{
+	unsigned int *dest = dst;
+	const unsigned int *sorc = src;
+	pixels /= 2;
+	if (darker)
+	{
+		while (pixels--)
+		{
+			unsigned int p = *sorc++;
+			*dest++ = ((p&0xf79ef79e)>>1) - ((p&0xc618c618)>>3);
+		}
+	}
+	else
+	{
+		while (pixels--)
+		{
+			unsigned int p = *sorc++;
+			*dest++ = (p&0xf79ef79e)>>1;
+		}
+	}
+}
+
+void pixops_rgb565_to_xrgb8888_c(uint32_t *dst, const uint16_t *src, int pixels)
+{
+	int i;
+
+	for (i = 0; i < pixels; i++) {
+		uint32_t c = src[i];
+		uint32_t r = c >> 11, g = (c >> 5) & 0x3f, b = c & 0x1f;
+
+		dst[i] = ((r << 3 | r >> 2) << 16) | ((g << 2 | g >> 4) << 8)
+			| (b << 3 | b >> 2);
+	}
+}
+
+struct pixops pixops = {
+	pixops_darken_bg_c,
+	pixops_rgb565_to_xrgb8888_c,
+};
+
+int pixops_init(void)
+{
+	unsigned int features = pixops_cpu_features();
+
+	(void)features;
+#if defined(__i386__) || defined(__x86_64__)
+	if (features & PIXOPS_CPU_SSE2) {
+		pixops.darken_bg = pixops_darken_bg_sse2;
+		pixops.rgb565_to_xrgb8888 = pixops_rgb565_to_xrgb8888_sse2;
+	}
+#endif
+#if defined(HAVE_NEON32) || defined(__ARM_NEON__) || defined(__ARM_NEON)
+	if (features & PIXOPS_CPU_NEON) {
+		pixops.darken_bg = pixops_darken_bg_neon;
+		pixops.rgb565_to_xrgb8888 = pixops_rgb565_to_xrgb8888_neon;
+	}
+#endif
+
+	filters_init();
+
+	return 0;
+}
@@ -0,0 +1,50 @@
+#ifndef LIBPICOFE_PIXOPS_H
+#define LIBPICOFE_PIXOPS_H
+
+#include <inttypes.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/* CPU features the kernels care about */
+#define PIXOPS_CPU_SSE2	(1 << 0)
+#define PIXOPS_CPU_AVX2	(1 << 1)
+#define PIXOPS_CPU_NEON	(1 << 2)
+
+unsigned int pixops_cpu_features(void);
+
+/*
+ * pixel kernels, pointing to the best versions for the running CPU
+ * after pixops_init() (plat_target_init() calls it), plain C before.
+ * Scalers from filters.h are selected by pixops_init() too.
+ * Platforms may override entries after init.
+ */
+struct pixops {
+	/* halve brightness of RGB565, darker also subtracts 1/8 */
+	void (*darken_bg)(void *dst, const void *src, int pixels, int darker);
+	void (*rgb565_to_xrgb8888)(uint32_t *dst, const uint16_t *src, int pixels);
+};
+
+extern struct pixops pixops;
+
+int pixops_init(void);
+
+/* C versions, also used for the tails by SIMD code */
+void pixops_darken_bg_c(void *dst, const void *src, int pixels, int darker);
+void pixops_rgb565_to_xrgb8888_c(uint32_t *dst, const uint16_t *src, int pixels);
+
+#if defined(__i386__) || defined(__x86_64__)
+void pixops_darken_bg_sse2(void *dst, const void *src, int pixels, int darker);
+void pixops_rgb565_to_xrgb8888_sse2(uint32_t *dst, const uint16_t *src, int pixels);
+#endif
+#if defined(HAVE_NEON32) || defined(__ARM_NEON__) || defined(__ARM_NEON)
+void pixops_darken_bg_neon(void *dst, const void *src, int pixels, int darker);
+void pixops_rgb565_to_xrgb8888_neon(uint32_t *dst, const uint16_t *src, int pixels);
+#endif
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* LIBPICOFE_PIXOPS_H */
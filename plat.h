@@ -2,6 +2,7 @@
 #define LIBPICOFE_PLAT_H
 
 #include <stdlib.h>
+#include <stdint.h>
 
 #ifdef __cplusplus
 extern "C" {
@@ -97,9 +98,34 @@ int  plat_get_root_dir(char *dst, int len);
 
 int  plat_is_dir(const char *path);
 int  plat_wait_event(int *fds_hnds, int count, int timeout_ms);
+
+/* persistent version of the above, handles stay registered between
+ * waits. wait returns the number of ready handles stored to ready[],
+ * 0 when the deadline (plat_get_ticks_ns() time) passed or on wake,
+ * -1 on error. wake can be called from any thread. create returns NULL
+ * where it's not supported (plat_dummy.c stubs outside of linux), and
+ * callers fall back to plat_wait_event() */
+#define PLAT_WAIT_FOREVER ((uint64_t)-1)
+struct plat_wait_set;
+struct plat_wait_set *plat_wait_set_create(void);
+int  plat_wait_set_add(struct plat_wait_set *ws, int fd_hnd);
+int  plat_wait_set_remove(struct plat_wait_set *ws, int fd_hnd);
+int  plat_wait_set_wait(struct plat_wait_set *ws, int *ready, int max,
+			uint64_t deadline_ns);
+void plat_wait_set_wake(struct plat_wait_set *ws);
+void plat_wait_set_destroy(struct plat_wait_set *ws);
 void plat_sleep_ms(int ms);
 
 void *plat_mmap(unsigned long addr, size_t size, int need_exec, int is_fixed);
+
+/* plat_mmap_ext() flags; HUGETLB/THP are only tried on big sizes,
+ * *got (if not NULL) receives the flags that actually took effect */
+#define PLAT_MMAP_EXEC		(1 << 0)
+#define PLAT_MMAP_FIXED		(1 << 1)
+#define PLAT_MMAP_HUGETLB	(1 << 2)	/* reserved hugetlbfs pages */
+#define PLAT_MMAP_THP		(1 << 3)	/* transparent huge pages */
+#define PLAT_MMAP_POPULATE	(1 << 4)	/* prefault now, not on first use */
+void *plat_mmap_ext(unsigned long addr, size_t size, int flags, int *got);
 void *plat_mremap(void *ptr, size_t oldsize, size_t newsize);
 void  plat_munmap(void *ptr, size_t size);
 
@@ -108,6 +134,19 @@ unsigned int plat_get_ticks_ms(void);
 unsigned int plat_get_ticks_us(void);
 void plat_wait_till_us(unsigned int us);
 
+/* monotonic and 64bit, so no wraps or jumps for any sane uptime.
+ * On linux this is CLOCK_MONOTONIC on every target (the GP2X/Wiz
+ * hardware timer only backs the ms/us ones there), so it's usable as
+ * an absolute clock_nanosleep()/timerfd deadline and compares with
+ * evdev event times. Other hosts build it on plat_get_ticks_us()
+ * (plat_dummy.c) */
+uint64_t plat_get_ticks_ns(void);
+
+static __inline uint64_t plat_get_ticks_us64(void)
+{
+	return plat_get_ticks_ns() / 1000;
+}
+
 void plat_debug_cat(char *str);
 
 #ifdef __cplusplus
@@ -1,9 +1,65 @@
+#include <pthread.h>
+
 #include "plat.h"
+#include "pixops.h"
 
 struct plat_target plat_target;
 
+#ifndef __linux__
+/* linux/plat.c has a native one, elsewhere count the wraps
+ * (every ~71 minutes) of the 32bit us timer */
+uint64_t plat_get_ticks_ns(void)
+{
+	static pthread_mutex_t mutex = PTHREAD_MUTEX_INITIALIZER;
+	static unsigned int last_us, wraps;
+	unsigned int us;
+	uint64_t ret;
+
+	pthread_mutex_lock(&mutex);
+	us = plat_get_ticks_us();
+	if (us < last_us)
+		wraps++;
+	last_us = us;
+	ret = ((uint64_t)wraps << 32 | us) * 1000;
+	pthread_mutex_unlock(&mutex);
+
+	return ret;
+}
+
+/* no persistent waits, input.c falls back to plat_wait_event() */
+struct plat_wait_set *plat_wait_set_create(void)
+{
+	return NULL;
+}
+
+int plat_wait_set_add(struct plat_wait_set *ws, int fd_hnd)
+{
+	return -1;
+}
+
+int plat_wait_set_remove(struct plat_wait_set *ws, int fd_hnd)
+{
+	return -1;
+}
+
+int plat_wait_set_wait(struct plat_wait_set *ws, int *ready, int max,
+		       uint64_t deadline_ns)
+{
+	return -1;
+}
+
+void plat_wait_set_wake(struct plat_wait_set *ws)
+{
+}
+
+void plat_wait_set_destroy(struct plat_wait_set *ws)
+{
+}
+#endif
+
 int plat_target_init(void)
 {
+	pixops_init();
 	return 0;
 }
 
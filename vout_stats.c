@@ -0,0 +1,239 @@
+/*
+ * presentation timestamps and frame pacing statistics
+ *
+ * This work is licensed under the terms of any of these licenses
+ * (at your option):
+ *  - GNU GPL, version 2 or later.
+ *  - GNU LGPL, version 2.1 or later.
+ *  - MAME license.
+ * See the COPYING file in the top-level directory.
+ */
+
+#include <stdlib.h>
+#include <string.h>
+#include <pthread.h>
+
+#include "plat.h"
+#include "vout_stats.h"
+
+/* frames may be presented from a flip thread */
+static pthread_mutex_t stats_mutex = PTHREAD_MUTEX_INITIALIZER;
+
+static struct vout_frame_stats frames[VOUT_STATS_FRAMES];
+static unsigned char presented[VOUT_STATS_FRAMES];
+static unsigned int next_id;
+static unsigned int last_id;
+static int have_last;
+
+static unsigned int refresh_set_us;
+static unsigned int refresh_mode_us;	/* from the driver, seeds the estimate */
+static unsigned int refresh_est_us;
+static unsigned int last_interval_us;
+static int have_vsync;
+
+unsigned int vout_stats_submit(unsigned int queued)
+{
+	unsigned int id, slot;
+
+	pthread_mutex_lock(&stats_mutex);
+	id = next_id++;
+	slot = id % VOUT_STATS_FRAMES;
+	frames[slot].submit_ns = plat_get_ticks_ns();
+	frames[slot].present_ns = 0;
+	frames[slot].missed = 0;
+	frames[slot].queued = queued;
+	presented[slot] = 0;
+	pthread_mutex_unlock(&stats_mutex);
+
+	return id;
+}
+
+void vout_stats_present(unsigned int id, uint64_t present_ns)
+{
+	struct vout_frame_stats *f = &frames[id % VOUT_STATS_FRAMES];
+	unsigned int interval, period, n, diff, stable;
+
+	pthread_mutex_lock(&stats_mutex);
+
+	// too old, slot reused
+	if (next_id - id > VOUT_STATS_FRAMES)
+		goto out;
+
+	f->present_ns = present_ns;
+	presented[id % VOUT_STATS_FRAMES] = 1;
+
+	if (have_last && id - last_id < VOUT_STATS_FRAMES) {
+		interval = (present_ns - frames[last_id % VOUT_STATS_FRAMES].present_ns) / 1000;
+
+		// anything under 2ms is not a real vblank interval.
+		// Two similar intervals in a row are a stable period, take
+		// it if it's shorter, else a 30fps start on a 60Hz screen
+		// would lock onto 2 periods. Smooth the rest so that a late
+		// present doesn't skew it
+		if (interval >= 2000) {
+			stable = 0;
+			if (last_interval_us != 0) {
+				diff = interval > last_interval_us
+					? interval - last_interval_us
+					: last_interval_us - interval;
+				if (diff <= last_interval_us / 8)
+					stable = (interval + last_interval_us) / 2;
+			}
+			if (stable != 0 && (refresh_est_us == 0
+			    || stable < refresh_est_us * 3 / 4))
+				refresh_est_us = stable;
+			else if (refresh_est_us != 0) {
+				n = (interval + refresh_est_us / 2) / refresh_est_us;
+				if (n < 1)
+					n = 1;
+				refresh_est_us += ((int)(interval / n) - (int)refresh_est_us) / 16;
+			}
+			last_interval_us = interval;
+		}
+
+		period = refresh_set_us ? refresh_set_us : refresh_est_us;
+		if (period != 0) {
+			n = (interval + period / 2) / period;
+			f->missed = n > 1 ? n - 1 : 0;
+		}
+	}
+	last_id = id;
+	have_last = 1;
+
+out:
+	pthread_mutex_unlock(&stats_mutex);
+}
+
+int vout_stats_last(struct vout_frame_stats *f)
+{
+	int ret = -1;
+
+	pthread_mutex_lock(&stats_mutex);
+	if (have_last) {
+		*f = frames[last_id % VOUT_STATS_FRAMES];
+		ret = 0;
+	}
+	pthread_mutex_unlock(&stats_mutex);
+
+	return ret;
+}
+
+static int cmp_uint(const void *p1, const void *p2)
+{
+	unsigned int a = *(const unsigned int *)p1;
+	unsigned int b = *(const unsigned int *)p2;
+	return a < b ? -1 : a > b;
+}
+
+static void percentiles(unsigned int *v, int n, unsigned int *out)
+{
+	static const int pct[3] = { 50, 90, 99 };
+	int i;
+
+	if (n == 0) {
+		memset(out, 0, sizeof(out[0]) * 3);
+		return;
+	}
+
+	qsort(v, n, sizeof(v[0]), cmp_uint);
+	for (i = 0; i < 3; i++)
+		out[i] = v[(n - 1) * pct[i] / 100];
+}
+
+void vout_stats_get(struct vout_stats *s)
+{
+	unsigned int latency[VOUT_STATS_FRAMES];
+	unsigned int interval[VOUT_STATS_FRAMES];
+	int n_lat = 0, n_int = 0;
+	unsigned int id;
+	uint64_t prev = 0;
+	int have_prev = 0;
+
+	memset(s, 0, sizeof(*s));
+
+	pthread_mutex_lock(&stats_mutex);
+
+	// walk the window oldest first
+	id = next_id - VOUT_STATS_FRAMES;
+	if (next_id < VOUT_STATS_FRAMES)
+		id = 0;
+	for (; id != next_id; id++) {
+		const struct vout_frame_stats *f = &frames[id % VOUT_STATS_FRAMES];
+
+		if (!presented[id % VOUT_STATS_FRAMES])
+			continue;
+
+		latency[n_lat++] = (f->present_ns - f->submit_ns) / 1000;
+		if (have_prev) {
+			interval[n_int] = (f->present_ns - prev) / 1000;
+			if (interval[n_int] > s->interval_max_us)
+				s->interval_max_us = interval[n_int];
+			n_int++;
+		}
+		prev = f->present_ns;
+		have_prev = 1;
+
+		s->frames++;
+		s->missed += f->missed;
+		if (f->queued > s->max_queued)
+			s->max_queued = f->queued;
+	}
+	s->refresh_us = refresh_set_us ? refresh_set_us : refresh_est_us;
+
+	pthread_mutex_unlock(&stats_mutex);
+
+	percentiles(latency, n_lat, s->latency_us);
+	percentiles(interval, n_int, s->interval_us);
+}
+
+void vout_stats_set_refresh(unsigned int period_us)
+{
+	pthread_mutex_lock(&stats_mutex);
+	refresh_set_us = period_us;
+	pthread_mutex_unlock(&stats_mutex);
+}
+
+void vout_stats_set_mode_refresh(unsigned int period_us)
+{
+	pthread_mutex_lock(&stats_mutex);
+	refresh_mode_us = period_us;
+	refresh_est_us = period_us;
+	last_interval_us = 0;
+	pthread_mutex_unlock(&stats_mutex);
+}
+
+void vout_stats_set_vsync(int enable)
+{
+	pthread_mutex_lock(&stats_mutex);
+	// don't mix in intervals from before the change
+	if (have_vsync != !!enable) {
+		have_vsync = !!enable;
+		refresh_est_us = refresh_mode_us;
+		last_interval_us = 0;
+	}
+	pthread_mutex_unlock(&stats_mutex);
+}
+
+unsigned int vout_stats_refresh_us(void)
+{
+	unsigned int ret;
+
+	pthread_mutex_lock(&stats_mutex);
+	if (refresh_set_us != 0)
+		ret = refresh_set_us;
+	else
+		ret = have_vsync ? refresh_est_us : 0;
+	pthread_mutex_unlock(&stats_mutex);
+
+	return ret;
+}
+
+void vout_stats_reset(void)
+{
+	pthread_mutex_lock(&stats_mutex);
+	memset(presented, 0, sizeof(presented));
+	have_last = 0;
+	refresh_est_us = refresh_mode_us;
+	last_interval_us = 0;
+	pthread_mutex_unlock(&stats_mutex);
+}
@@ -0,0 +1,63 @@
+#ifndef LIBPICOFE_VOUT_STATS_H
+#define LIBPICOFE_VOUT_STATS_H
+
+#include <stdint.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/*
+ * Presentation feedback. The vout backends (linux/fbdev.c, gl.c)
+ * record when each frame was submitted and when it reached the
+ * screen; hosts that flip by themselves (SDL_Flip and such) can do
+ * the same with vout_stats_submit()/vout_stats_present().
+ * Times are plat_get_ticks_ns(), stats cover the last
+ * VOUT_STATS_FRAMES presented frames.
+ */
+#define VOUT_STATS_FRAMES 256
+
+struct vout_frame_stats {
+	uint64_t submit_ns;
+	uint64_t present_ns;		/* vsync/flip done */
+	unsigned int missed;		/* vblanks without a new frame before it */
+	unsigned int queued;		/* flips still pending at submit */
+};
+
+struct vout_stats {
+	unsigned int frames;
+	unsigned int missed;
+	unsigned int refresh_us;	/* vblank period used for missed counts */
+	unsigned int max_queued;
+	/* 50th, 90th, 99th percentiles */
+	unsigned int latency_us[3];	/* submit -> present */
+	unsigned int interval_us[3];	/* present -> present */
+	unsigned int interval_max_us;
+};
+
+/* returns a frame id to pass to vout_stats_present() */
+unsigned int vout_stats_submit(unsigned int queued);
+void vout_stats_present(unsigned int frame, uint64_t present_ns);
+
+/* latest presented frame, -1 if none yet */
+int  vout_stats_last(struct vout_frame_stats *f);
+void vout_stats_get(struct vout_stats *s);
+
+/* nominal vblank period, 0 to estimate it from present intervals */
+void vout_stats_set_refresh(unsigned int period_us);
+/* backends pass the period of the video mode if they know it (0 if
+ * not), the estimate starts from it instead of the first intervals */
+void vout_stats_set_mode_refresh(unsigned int period_us);
+/* backends tell if present times come from a vblank wait; without
+ * one they only follow how fast frames are submitted */
+void vout_stats_set_vsync(int enable);
+/* period in use, 0 if not known yet, estimates only count with vsync;
+ * cheap enough to call every frame */
+unsigned int vout_stats_refresh_us(void);
+void vout_stats_reset(void);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* LIBPICOFE_VOUT_STATS_H */
@@ -0,0 +1,45 @@
+/*
+ * scale/eagle line kernels, AVX2
+ *
+ * This work is licensed under the terms of any of these licenses
+ * (at your option):
+ *  - GNU GPL, version 2 or later.
+ *  - GNU LGPL, version 2.1 or later.
+ *  - MAME license.
+ * See the COPYING file in the top-level directory.
+ */
+
+#if defined(__i386__) || defined(__x86_64__)
+
+#include <immintrin.h>
+#include "../filters_int.h"
+
+#define V		__m256i
+#define VB		32
+#define V_ATTR		__attribute__((target("avx2")))
+#define V_LOAD(p)	_mm256_loadu_si256((const __m256i *)(p))
+#define V_STORE(p, v)	_mm256_storeu_si256((__m256i *)(p), v)
+#define V_CMPEQ8	_mm256_cmpeq_epi8
+#define V_CMPEQ16	_mm256_cmpeq_epi16
+#define V_AND		_mm256_and_si256
+#define V_OR		_mm256_or_si256
+#define V_ANDNOT	_mm256_andnot_si256
+#define V_SEL(m, a, b)	_mm256_blendv_epi8(b, a, m)
+/* unpack works within 128bit lanes, so fix up the order after it */
+#define V_ZIP8(a, b, lo, hi) { \
+	__m256i l_ = _mm256_unpacklo_epi8(a, b); \
+	__m256i h_ = _mm256_unpackhi_epi8(a, b); \
+	lo = _mm256_permute2x128_si256(l_, h_, 0x20); \
+	hi = _mm256_permute2x128_si256(l_, h_, 0x31); \
+}
+#define V_ZIP16(a, b, lo, hi) { \
+	__m256i l_ = _mm256_unpacklo_epi16(a, b); \
+	__m256i h_ = _mm256_unpackhi_epi16(a, b); \
+	lo = _mm256_permute2x128_si256(l_, h_, 0x20); \
+	hi = _mm256_permute2x128_si256(l_, h_, 0x31); \
+}
+#define V_LINES		filter_lines_avx2
+
+#include "../filters_tmpl.h"
+
+#endif
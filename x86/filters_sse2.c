@@ -0,0 +1,40 @@
+/*
+ * scale/eagle line kernels, SSE2
+ *
+ * This work is licensed under the terms of any of these licenses
+ * (at your option):
+ *  - GNU GPL, version 2 or later.
+ *  - GNU LGPL, version 2.1 or later.
+ *  - MAME license.
+ * See the COPYING file in the top-level directory.
+ */
+
+#if defined(__i386__) || defined(__x86_64__)
+
+#include <emmintrin.h>
+#include "../filters_int.h"
+
+#define V		__m128i
+#define VB		16
+#define V_ATTR		__attribute__((target("sse2")))
+#define V_LOAD(p)	_mm_loadu_si128((const __m128i *)(p))
+#define V_STORE(p, v)	_mm_storeu_si128((__m128i *)(p), v)
+#define V_CMPEQ8	_mm_cmpeq_epi8
+#define V_CMPEQ16	_mm_cmpeq_epi16
+#define V_AND		_mm_and_si128
+#define V_OR		_mm_or_si128
+#define V_ANDNOT	_mm_andnot_si128
+#define V_SEL(m, a, b)	_mm_or_si128(_mm_and_si128(m, a), _mm_andnot_si128(m, b))
+#define V_ZIP8(a, b, lo, hi) { \
+	lo = _mm_unpacklo_epi8(a, b); \
+	hi = _mm_unpackhi_epi8(a, b); \
+}
+#define V_ZIP16(a, b, lo, hi) { \
+	lo = _mm_unpacklo_epi16(a, b); \
+	hi = _mm_unpackhi_epi16(a, b); \
+}
+#define V_LINES		filter_lines_sse2
+
+#include "../filters_tmpl.h"
+
+#endif
@@ -0,0 +1,65 @@
+/*
+ * pixel kernels, SSE2
+ *
+ * This work is licensed under the terms of any of these licenses
+ * (at your option):
+ *  - GNU GPL, version 2 or later.
+ *  - GNU LGPL, version 2.1 or later.
+ *  - MAME license.
+ * See the COPYING file in the top-level directory.
+ */
+
+#if defined(__i386__) || defined(__x86_64__)
+
+#include <emmintrin.h>
+#include "../pixops.h"
+
+#define ATTR __attribute__((target("sse2")))
+
+ATTR void pixops_darken_bg_sse2(void *dst, const void *src, int pixels,
+	int darker)
+{
+	const __m128i m1 = _mm_set1_epi32(0xf79ef79e);
+	const __m128i m3 = _mm_set1_epi32(0xc618c618);
+	uint16_t *d = dst;
+	const uint16_t *s = src;
+	int i;
+
+	for (i = 0; i + 8 <= pixels; i += 8) {
+		__m128i p = _mm_loadu_si128((const __m128i *)(s + i));
+		__m128i r = _mm_srli_epi32(_mm_and_si128(p, m1), 1);
+		if (darker)
+			r = _mm_sub_epi32(r, _mm_srli_epi32(_mm_and_si128(p, m3), 3));
+		_mm_storeu_si128((__m128i *)(d + i), r);
+	}
+
+	pixops_darken_bg_c(d + i, s + i, pixels - i, darker);
+}
+
+ATTR void pixops_rgb565_to_xrgb8888_sse2(uint32_t *dst, const uint16_t *src,
+	int pixels)
+{
+	const __m128i mf8 = _mm_set1_epi16(0xf8), mfc = _mm_set1_epi16(0xfc);
+	const __m128i m7 = _mm_set1_epi16(7), m3 = _mm_set1_epi16(3);
+	int i;
+
+	for (i = 0; i + 8 <= pixels; i += 8) {
+		__m128i p = _mm_loadu_si128((const __m128i *)(src + i));
+		__m128i r, g, b, bg;
+
+		r = _mm_or_si128(_mm_and_si128(_mm_srli_epi16(p, 8), mf8),
+			_mm_srli_epi16(p, 13));
+		g = _mm_or_si128(_mm_and_si128(_mm_srli_epi16(p, 3), mfc),
+			_mm_and_si128(_mm_srli_epi16(p, 9), m3));
+		b = _mm_or_si128(_mm_and_si128(_mm_slli_epi16(p, 3), mf8),
+			_mm_and_si128(_mm_srli_epi16(p, 2), m7));
+		bg = _mm_or_si128(b, _mm_slli_epi16(g, 8));
+
+		_mm_storeu_si128((__m128i *)(dst + i), _mm_unpacklo_epi16(bg, r));
+		_mm_storeu_si128((__m128i *)(dst + i + 4), _mm_unpackhi_epi16(bg, r));
+	}
+
+	pixops_rgb565_to_xrgb8888_c(dst + i, src + i, pixels - i);
+}
+
+#endif